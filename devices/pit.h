@@ -1,8 +1,17 @@
 #ifndef DEVICES_PIT_H
 #define DEVICES_PIT_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
+/* PIT cycles per second. */
+#define PIT_HZ 1193180
+
 void pit_configure_channel (int channel, int mode, int frequency);
+/*Added by moon*/
+void pit_configure_oneshot (int channel, unsigned count);
+unsigned pit_read_count (int channel);
+bool pit_output_high (int channel);
+/*Added by moon*/
 
 #endif /* devices/pit.h */
@@ -5,10 +5,17 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "threads/io.h"
+#include "threads/palloc.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
 #endif
+/*Added by moon*/
+#ifdef VM
+#include "vm/frame.h"
+#endif
+/*Added by moon*/
 #ifdef FILESYS
 #include "devices/block.h"
 #include "filesys/filesys.h"
@@ -128,4 +135,13 @@ print_stats (void)
 #ifdef USERPROG
   exception_print_stats ();
 #endif
+  /*Added by moon*/
+#ifdef USERPROG
+  palloc_print_stats ();
+#endif
+#ifdef VM
+  frame_print_stats ();
+#endif
+  trace_dump ();
+  /*Added by moon*/
 }
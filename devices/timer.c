@@ -20,6 +20,35 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/*Added by moon*/
+/*保护ticks，读ticks时不需要关中断*/
+static struct seqlock ticks_seq;
+/*Added by moon*/
+
+/*Added by moon*/
+/*正在睡眠的线程队列，按照唤醒时刻从早到晚排列*/
+static struct list sleep_list;
+
+/* If true, stop the periodic tick while the CPU is idle.
+   Controlled by kernel command-line option "-tickless". */
+bool timer_tickless;
+
+/*PIT每个timer tick的时钟周期数*/
+#define PIT_CYCLES_PER_TICK ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/*periodic模式下离下一次中断太近时不切换到one-shot，避免读计数和重新设置PIT
+之间错过这次中断*/
+#define ONESHOT_MARGIN (PIT_CYCLES_PER_TICK / 16)
+
+/*当前设置的one-shot中断到来时应该补上的tick数，为0时PIT处于periodic模式*/
+static int64_t oneshot_ticks;
+static unsigned oneshot_cycles;   /*one-shot设置的总周期数*/
+static unsigned oneshot_first;    /*从设置one-shot到第一个tick边界的周期数*/
+
+static long long tickless_entries; /*idle时切换到one-shot模式的次数*/
+static long long tickless_skipped; /*因此省掉的timer中断次数*/
+/*Added by moon*/
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
@@ -29,6 +58,10 @@ static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
+/*Added by moon*/
+static bool wakeup_earlier (const struct list_elem *, const struct list_elem *,
+                            void *aux);
+/*Added by moon*/
 
 /* Sets up the timer to interrupt TIMER_FREQ times per second,
    and registers the corresponding interrupt. */
@@ -36,6 +69,10 @@ void
 timer_init (void) 
 {
   pit_configure_channel (0, 2, TIMER_FREQ);
+  /*Added by moon*/
+  list_init (&sleep_list);
+  seqlock_init (&ticks_seq);
+  /*Added by moon*/
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
 
@@ -70,10 +107,18 @@ timer_calibrate (void)
 int64_t
 timer_ticks (void) 
 {
-  enum intr_level old_level = intr_disable ();
-  int64_t t = ticks;
-  intr_set_level (old_level);
+  /*Added by moon*/
+  /*ticks是64位的，要分两次读，读的过程中被timer中断修改过就重读*/
+  unsigned seq;
+  int64_t t;
+  do
+    {
+      seq = seqlock_read_begin (&ticks_seq);
+      t = ticks;
+    }
+  while (seqlock_read_retry (&ticks_seq, seq));
   return t;
+  /*Added by moon*/
 }
 
 /* Returns the number of timer ticks elapsed since THEN, which
@@ -100,7 +145,9 @@ timer_sleep (int64_t ticks)
 
   enum intr_level old_level = intr_disable ();
   struct thread* curThread = thread_current();
-  curThread->ticks_blocked = ticks;  /*当前线程应该睡眠的时间*/
+  /*记录绝对的唤醒时刻，并按照唤醒时刻的顺序放入睡眠队列*/
+  curThread->wakeup_ticks = timer_ticks () + ticks;
+  list_insert_ordered (&sleep_list, &curThread->elem, wakeup_earlier, NULL);
   thread_block();
   intr_set_level (old_level);
 }
@@ -173,21 +220,130 @@ void
 timer_print_stats (void) 
 {
   printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  /*Added by moon*/
+  if (timer_tickless)
+    printf ("Timer: %lld tickless idle periods, %lld interrupts skipped\n",
+            tickless_entries, tickless_skipped);
+  /*Added by moon*/
+}
+
+/*Added by moon*/
+/*idle线程在关中断的情况下、执行hlt之前调用。如果打开了tickless模式，
+就把PIT从periodic模式切换到one-shot模式，直接在最早的睡眠线程到期的那个
+tick边界上中断，中间的tick都不再产生中断。16位的计数器最多只能覆盖大约5个
+tick，更长的空闲时间会分成几段*/
+void
+timer_idle_enter (void)
+{
+  int64_t n;
+  unsigned left;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!timer_tickless || oneshot_ticks > 0)
+    return;
+
+  left = pit_read_count (0);
+  if (left < ONESHOT_MARGIN || left > PIT_CYCLES_PER_TICK)
+    return;
+
+  /*计数器能容纳的最多的tick数*/
+  n = 1 + (0xffff - left) / PIT_CYCLES_PER_TICK;
+  if (!list_empty (&sleep_list))
+    {
+      struct thread *t = list_entry (list_front (&sleep_list),
+                                     struct thread, elem);
+      if (t->wakeup_ticks - ticks < n)
+        n = t->wakeup_ticks - ticks;
+    }
+  if (n <= 1)
+    return;
+
+  oneshot_first = left;
+  oneshot_cycles = left + (n - 1) * PIT_CYCLES_PER_TICK;
+  oneshot_ticks = n;
+  pit_configure_oneshot (0, oneshot_cycles);
+  tickless_entries++;
 }
+
+/*idle线程被hlt唤醒之后在关中断的情况下调用。如果唤醒它的不是one-shot中断
+本身，就根据已经走过的周期数算出跨过了几个tick边界，把one-shot改成在下一个
+tick边界中断，届时把这些tick一起补上，这样有线程被唤醒时最多只会晚一个tick
+恢复periodic模式*/
+void
+timer_idle_exit (void)
+{
+  unsigned rem, elapsed, crossed;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (oneshot_ticks == 0)
+    return;
+
+  /*计数已经到0的话中断已经在等待处理，交给timer_interrupt去补*/
+  if (pit_output_high (0))
+    return;
+  rem = pit_read_count (0);
+  if (rem == 0 || rem > oneshot_cycles)
+    return;
+
+  elapsed = oneshot_cycles - rem;
+  crossed = (elapsed < oneshot_first
+             ? 0 : 1 + (elapsed - oneshot_first) / PIT_CYCLES_PER_TICK);
+  oneshot_first = oneshot_cycles = oneshot_first
+                                   + crossed * PIT_CYCLES_PER_TICK - elapsed;
+  oneshot_ticks = crossed + 1;
+  pit_configure_oneshot (0, oneshot_cycles);
+}
+/*Added by moon*/
 
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
 {
-  ticks++;
   /*Added by moon*/
-  enum intr_level old_level = intr_disable ();
-  thread_foreach(checkInvoke,NULL); /*对全部线程都执行checkInvoke的操作*/
-  intr_set_level (old_level);
+  /*one-shot中断代表idle期间走过的多个tick，恢复periodic模式后逐个补上*/
+  int64_t n = 1;
+  if (oneshot_ticks > 0)
+    {
+      n = oneshot_ticks;
+      oneshot_ticks = 0;
+      pit_configure_channel (0, 2, TIMER_FREQ);
+      tickless_skipped += n - 1;
+    }
+
+  while (n-- > 0)
+    {
+      enum intr_level old_level = seqlock_write_begin (&ticks_seq);
+      ticks++;
+      seqlock_write_end (&ticks_seq, old_level);
+      /*睡眠队列是按唤醒时刻排好序的，只需要从队列头开始唤醒已经到期的线程，
+      没有线程到期时只检查一次队列头*/
+      while (!list_empty (&sleep_list))
+        {
+          struct thread *t = list_entry (list_front (&sleep_list),
+                                         struct thread, elem);
+          if (t->wakeup_ticks > ticks)
+            break;
+          list_pop_front (&sleep_list);
+          thread_unblock (t);
+        }
+      thread_tick ();
+    }
   /*Added by moon*/
-  thread_tick ();
 }
 
+/*Added by moon*/
+/*判断两个list_elem对应的睡眠线程哪个应该先被唤醒，唤醒时刻相同时保持先来先唤醒*/
+static bool
+wakeup_earlier (const struct list_elem *a, const struct list_elem *b,
+                void *aux UNUSED)
+{
+  return (list_entry (a, struct thread, elem)->wakeup_ticks
+          < list_entry (b, struct thread, elem)->wakeup_ticks);
+}
+/*Added by moon*/
+
 /* Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
 static bool
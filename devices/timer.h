@@ -2,6 +2,7 @@
 #define DEVICES_TIMER_H
 
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
@@ -26,4 +27,14 @@ void timer_ndelay (int64_t nanoseconds);
 
 void timer_print_stats (void);
 
+/*Added by moon*/
+/* If true, stop the periodic tick while the CPU is idle.
+   Controlled by kernel command-line option "-tickless". */
+extern bool timer_tickless;
+
+/* Tickless idle. */
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+/*Added by moon*/
+
 #endif /* devices/timer.h */
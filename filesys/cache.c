@@ -0,0 +1,378 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <round.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+/*Added by moon*/
+#include "filesys/free-map.h"
+/*Added by moon*/
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "threads/vmalloc.h"
+
+/*Added by moon*/
+/*缓存的扇区数*/
+#define CACHE_SIZE 64
+
+/*写回线程两次写回之间的时间间隔，以tick为单位*/
+#define FLUSH_INTERVAL TIMER_FREQ
+
+/*等待预读的扇区队列的长度，满了的时候新的请求直接丢弃*/
+#define READ_AHEAD_QUEUE 16
+
+/* A cached sector. */
+struct cache_entry
+  {
+    block_sector_t sector;      /* Sector cached, if VALID. */
+    bool valid;                 /* Holds a sector? */
+    bool dirty;                 /* Modified since read or written back? */
+    bool accessed;              /* Used since the clock hand passed? */
+    bool busy;                  /* I/O in progress? */
+    bool filling;               /* Claimed, first write not copied yet? */
+    int pin_cnt;                /* Threads copying data; no eviction. */
+    bool first;                 /* Written back before other sectors? */
+    uint8_t *data;              /* BLOCK_SECTOR_SIZE bytes of data. */
+  };
+
+static struct cache_entry entries[CACHE_SIZE];
+
+/*时钟算法的指针*/
+static size_t clock_hand;
+
+/*保护entries、clock_hand和预读队列。读写磁盘时释放锁，这期间这一项被
+标记为busy。和调用者的缓冲区之间复制数据时也释放锁，因为缓冲区可能是
+还没调入的用户页，缺页处理会再次访问缓存；这期间这一项被钉住，不会被换出
+或写回*/
+static struct lock cache_lock;
+
+/*有一项的I/O完成、第一次写入完成或者不再被钉住时广播*/
+static struct condition io_done;
+
+/*等待预读的扇区，循环队列*/
+static block_sector_t ra_queue[READ_AHEAD_QUEUE];
+static size_t ra_head, ra_cnt;
+static struct semaphore ra_wakeup;
+
+static struct cache_entry *get_entry (block_sector_t, bool need_read);
+static struct cache_entry *find_entry (block_sector_t);
+static struct cache_entry *pick_victim (void);
+static void unpin (struct cache_entry *);
+static void write_entry (block_sector_t, const void *, int ofs, int size,
+                         bool first);
+static void write_back_first (void);
+static void write_back (struct cache_entry *);
+static thread_func flush_thread NO_RETURN;
+static thread_func read_ahead_thread NO_RETURN;
+
+/* Initializes the buffer cache and starts its flusher and
+   read-ahead threads. */
+void
+cache_init (void)
+{
+  uint8_t *data;
+  size_t i;
+
+  data = vmalloc (DIV_ROUND_UP (CACHE_SIZE * BLOCK_SECTOR_SIZE, PGSIZE),
+                  PAL_ASSERT);
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      entries[i].valid = false;
+      entries[i].dirty = false;
+      entries[i].accessed = false;
+      entries[i].busy = false;
+      entries[i].filling = false;
+      entries[i].pin_cnt = 0;
+      entries[i].first = false;
+      entries[i].data = data + i * BLOCK_SECTOR_SIZE;
+    }
+  clock_hand = 0;
+  lock_init (&cache_lock);
+  cond_init (&io_done);
+  sema_init (&ra_wakeup, 0);
+
+  thread_create ("flushd", PRI_DEFAULT, flush_thread, NULL);
+  thread_create ("readaheadd", PRI_DEFAULT, read_ahead_thread, NULL);
+}
+
+/* Reads SIZE bytes starting at offset OFS within SECTOR of
+   fs_device into BUFFER. */
+void
+cache_read (block_sector_t sector, void *buffer, int ofs, int size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  lock_acquire (&cache_lock);
+  e = get_entry (sector, true);
+  e->pin_cnt++;
+  lock_release (&cache_lock);
+
+  memcpy (buffer, e->data + ofs, size);
+
+  lock_acquire (&cache_lock);
+  e->accessed = true;
+  unpin (e);
+  lock_release (&cache_lock);
+}
+
+/* Writes SIZE bytes from BUFFER into SECTOR of fs_device,
+   starting at offset OFS within the sector.  The data reaches
+   the disk later, when the sector is written back. */
+void
+cache_write (block_sector_t sector, const void *buffer, int ofs, int size)
+{
+  write_entry (sector, buffer, ofs, size, false);
+}
+
+/* Like cache_write(), but SECTOR is written back before any
+   sector written with cache_write(). */
+void
+cache_write_first (block_sector_t sector, const void *buffer, int ofs,
+                   int size)
+{
+  write_entry (sector, buffer, ofs, size, true);
+}
+
+/*见cache_write()和cache_write_first()*/
+static void
+write_entry (block_sector_t sector, const void *buffer, int ofs, int size,
+             bool first)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  lock_acquire (&cache_lock);
+  /*整个扇区都要被覆盖时不用先读入*/
+  e = get_entry (sector, size < BLOCK_SECTOR_SIZE);
+  e->first = first;
+  e->pin_cnt++;
+  lock_release (&cache_lock);
+
+  memcpy (e->data + ofs, buffer, size);
+
+  /*被钉住的项不会被写回，所以不会有只复制了一部分的数据到达磁盘*/
+  lock_acquire (&cache_lock);
+  e->accessed = true;
+  e->dirty = true;
+  if (e->filling)
+    {
+      e->filling = false;
+      cond_broadcast (&io_done, &cache_lock);
+    }
+  unpin (e);
+  lock_release (&cache_lock);
+}
+
+/* Asks the read-ahead thread to bring SECTOR into the cache in
+   the background.  Does not wait; the request may be dropped. */
+void
+cache_read_ahead (block_sector_t sector)
+{
+  lock_acquire (&cache_lock);
+  if (ra_cnt < READ_AHEAD_QUEUE && find_entry (sector) == NULL)
+    {
+      ra_queue[(ra_head + ra_cnt++) % READ_AHEAD_QUEUE] = sector;
+      sema_up (&ra_wakeup);
+    }
+  lock_release (&cache_lock);
+}
+
+/* Writes every dirty sector in the cache back to disk. */
+void
+cache_flush (void)
+{
+  size_t i;
+
+  lock_acquire (&cache_lock);
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &entries[i];
+      /*write_back()可能要先等待别的项，返回时E不一定已经写回*/
+      while (e->busy || e->pin_cnt > 0 || (e->valid && e->dirty))
+        if (e->busy || e->pin_cnt > 0)
+          cond_wait (&io_done, &cache_lock);
+        else
+          write_back (e);
+    }
+  lock_release (&cache_lock);
+}
+
+/*返回缓存SECTOR的项，还没有缓存时换出一项来存放它，NEED_READ为true时
+从磁盘读入。NEED_READ为false时新换来的项里还是原来那个扇区的数据，项被
+标记为filling，别的线程要等调用者写入之后才能使用它。
+必须持有cache_lock，读写磁盘时会暂时释放它*/
+static struct cache_entry *
+get_entry (block_sector_t sector, bool need_read)
+{
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  for (;;)
+    {
+      struct cache_entry *e = find_entry (sector);
+      if (e != NULL)
+        {
+          if (!e->busy && !e->filling)
+            return e;
+          cond_wait (&io_done, &cache_lock);
+          continue;
+        }
+
+      e = pick_victim ();
+      if (e == NULL)
+        {
+          /*所有的项都在进行I/O或者被钉住*/
+          cond_wait (&io_done, &cache_lock);
+          continue;
+        }
+      if (e->valid && e->dirty)
+        {
+          /*写回期间别的线程可能已经读入了SECTOR，写完后重新查找*/
+          write_back (e);
+          continue;
+        }
+
+      e->sector = sector;
+      e->valid = true;
+      e->dirty = false;
+      e->first = false;
+      e->filling = !need_read;
+      if (need_read)
+        {
+          e->busy = true;
+          lock_release (&cache_lock);
+          block_read (fs_device, sector, e->data);
+          lock_acquire (&cache_lock);
+          e->busy = false;
+          cond_broadcast (&io_done, &cache_lock);
+        }
+      return e;
+    }
+}
+
+/*返回缓存SECTOR的项，没有时返回NULL。必须持有cache_lock*/
+static struct cache_entry *
+find_entry (block_sector_t sector)
+{
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (entries[i].valid && entries[i].sector == sector)
+      return &entries[i];
+  return NULL;
+}
+
+/*用时钟算法选出一项用来存放新的扇区，所有的项都在进行I/O或者被钉住时
+返回NULL。必须持有cache_lock*/
+static struct cache_entry *
+pick_victim (void)
+{
+  size_t i;
+
+  for (i = 0; i < 2 * CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &entries[clock_hand];
+      clock_hand = (clock_hand + 1) % CACHE_SIZE;
+      if (e->busy || e->pin_cnt > 0)
+        continue;
+      if (!e->valid || !e->accessed)
+        return e;
+      e->accessed = false;
+    }
+  return NULL;
+}
+
+/*解除对E的一次钉住，最后一次解除时唤醒等待可换出项的线程。
+必须持有cache_lock*/
+static void
+unpin (struct cache_entry *e)
+{
+  ASSERT (e->pin_cnt > 0);
+
+  if (--e->pin_cnt == 0)
+    cond_broadcast (&io_done, &cache_lock);
+}
+
+/*把脏的项E写回磁盘。必须持有cache_lock，写的时候会暂时释放它。
+
+E不是用cache_write_first()写的时，先写回所有用它写的脏项，见cache.h。
+写的期间E被标记为busy，不能被修改，所以写到磁盘上的E引用的扇区在磁盘上
+都已经被标记为已用*/
+static void
+write_back (struct cache_entry *e)
+{
+  if (!e->first)
+    {
+      write_back_first ();
+      /*等待的时候E可能已经被别的线程写回或者换出*/
+      if (!e->valid || !e->dirty || e->busy || e->pin_cnt > 0)
+        return;
+    }
+  ASSERT (e->valid && e->dirty && !e->busy && e->pin_cnt == 0);
+
+  e->busy = true;
+  e->dirty = false;
+  lock_release (&cache_lock);
+  block_write (fs_device, e->sector, e->data);
+  lock_acquire (&cache_lock);
+  e->busy = false;
+  cond_broadcast (&io_done, &cache_lock);
+}
+
+/*写回所有用cache_write_first()写的脏项，也等待正在写回和正在被修改的
+这种项。必须持有cache_lock，会暂时释放它，所以每写一项都要从头检查*/
+static void
+write_back_first (void)
+{
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &entries[i];
+      if (!e->valid || !e->first || (!e->dirty && !e->busy && e->pin_cnt == 0))
+        continue;
+      if (e->busy || e->pin_cnt > 0)
+        cond_wait (&io_done, &cache_lock);
+      else
+        write_back (e);
+      i = -1;
+    }
+}
+
+/*写回线程，定期把脏的扇区写回磁盘，这样系统崩溃时丢失的数据不会太多*/
+static void
+flush_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      timer_sleep (FLUSH_INTERVAL);
+      /*Added by moon*/
+      /*空闲位图要和缓存一起写回，见free_map_flush()*/
+      free_map_flush ();
+      /*Added by moon*/
+      cache_flush ();
+    }
+}
+
+/*预读线程，把cache_read_ahead()请求的扇区读入缓存*/
+static void
+read_ahead_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      block_sector_t sector;
+
+      sema_down (&ra_wakeup);
+      lock_acquire (&cache_lock);
+      sector = ra_queue[ra_head];
+      ra_head = (ra_head + 1) % READ_AHEAD_QUEUE;
+      ra_cnt--;
+      get_entry (sector, true);
+      lock_release (&cache_lock);
+    }
+}
+/*Added by moon*/
@@ -0,0 +1,32 @@
+#ifndef FILESYS_CACHE_H
+#define FILESYS_CACHE_H
+
+/*Added by moon*/
+#include "devices/block.h"
+
+/* Buffer cache.
+
+   All file system access to fs_device goes through a fixed-size
+   cache of sectors.  Sectors are replaced with the clock
+   algorithm.  Writes only modify the cache; a flusher thread
+   writes dirty sectors back periodically ("write-behind"), and
+   cache_flush() writes back everything, for example when the
+   file system is shut down.  A read-ahead thread loads sectors
+   that are expected to be read soon in the background.
+
+   Sectors written with cache_write_first() are written back
+   before any other dirty sector, whether by the flusher, by
+   cache_flush() or to make room for another sector.  This orders
+   the free map ahead of the metadata that uses newly allocated
+   sectors. */
+
+void cache_init (void);
+void cache_read (block_sector_t, void *buffer, int ofs, int size);
+void cache_write (block_sector_t, const void *buffer, int ofs, int size);
+void cache_write_first (block_sector_t, const void *buffer, int ofs,
+                        int size);
+void cache_read_ahead (block_sector_t);
+void cache_flush (void);
+/*Added by moon*/
+
+#endif /* filesys/cache.h */
@@ -2,6 +2,11 @@
 #include <stdio.h>
 #include <string.h>
 #include <list.h>
+/*Added by moon*/
+#include <hash.h>
+#include <round.h>
+#include <stdint.h>
+/*Added by moon*/
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
@@ -21,12 +26,87 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
+/*Added by moon*/
+/* On-disk directory layout.
+
+   A directory is a hash table of sector-sized blocks.  Block 0
+   is a header.  Blocks 1 through BUCKET_CNT are the buckets; an
+   entry lives in bucket hash_string(name) % BUCKET_CNT.  A full
+   bucket is extended by a chain of overflow blocks, which are
+   appended after the buckets.  When the directory becomes more
+   than 3/4 full, the number of buckets is doubled and every
+   entry is rehashed, so that a lookup normally reads one
+   block.
+
+   Deleted entries are only marked free, and the slot is reused
+   by the next entry added to the same bucket. */
+
+/* Identifies a directory header. */
+#define DIR_MAGIC 0x44495248
+
+/* Number of entries in a block. */
+#define DIR_SLOTS ((BLOCK_SECTOR_SIZE - sizeof (uint32_t)) \
+                   / sizeof (struct dir_entry))
+
+/* Directory header, at the start of block 0.
+   The rest of block 0 is not used. */
+struct dir_header
+  {
+    unsigned magic;                     /* Magic number. */
+    uint32_t bucket_cnt;                /* Number of buckets, a power of 2. */
+    uint32_t overflow_cnt;              /* Number of overflow blocks. */
+    uint32_t entry_cnt;                 /* Number of entries in use. */
+  };
+
+/* A bucket or overflow block.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct dir_block
+  {
+    struct dir_entry entries[DIR_SLOTS]; /* Entries. */
+    uint32_t next;                      /* Next overflow block, 0 if none. */
+    uint8_t unused[BLOCK_SECTOR_SIZE - sizeof (uint32_t)
+                   - DIR_SLOTS * sizeof (struct dir_entry)];
+  };
+
+static bool read_header (const struct dir *, struct dir_header *);
+static bool write_header (struct dir *, const struct dir_header *);
+static bool read_block (const struct dir *, uint32_t, struct dir_block *);
+static bool write_block (struct dir *, uint32_t, const struct dir_block *);
+static uint32_t bucket_of (const struct dir_header *, const char *name);
+static bool insert (struct dir *, struct dir_header *,
+                    const struct dir_entry *);
+static bool rehash (struct dir *, struct dir_header *);
+/*Added by moon*/
+
 /* Creates a directory with space for ENTRY_CNT entries in the
    given SECTOR.  Returns true if successful, false on failure. */
 bool
 dir_create (block_sector_t sector, size_t entry_cnt)
 {
-  return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+  /*Added by moon*/
+  struct dir_header h;
+  struct inode *inode;
+  bool success;
+
+  ASSERT (sizeof (struct dir_block) == BLOCK_SECTOR_SIZE);
+
+  h.magic = DIR_MAGIC;
+  h.bucket_cnt = 1;
+  h.overflow_cnt = 0;
+  h.entry_cnt = 0;
+  while (h.bucket_cnt * DIR_SLOTS * 3 / 4 < entry_cnt)
+    h.bucket_cnt *= 2;
+
+  /*inode的数据都是清零的，所以桶一开始都是空的*/
+  if (!inode_create (sector, (1 + h.bucket_cnt) * BLOCK_SECTOR_SIZE))
+    return false;
+  inode = inode_open (sector);
+  if (inode == NULL)
+    return false;
+  success = inode_write_at (inode, &h, sizeof h, 0) == sizeof h;
+  inode_close (inode);
+  return success;
+  /*Added by moon*/
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -35,7 +115,15 @@ struct dir *
 dir_open (struct inode *inode) 
 {
   struct dir *dir = calloc (1, sizeof *dir);
-  if (inode != NULL && dir != NULL)
+  /*Added by moon*/
+  struct dir_header h;
+  /*Added by moon*/
+
+  if (inode != NULL && dir != NULL
+      /*Added by moon*/
+      && inode_read_at (inode, &h, sizeof h, 0) == sizeof h
+      && h.magic == DIR_MAGIC
+      /*Added by moon*/)
     {
       dir->inode = inode;
       dir->pos = 0;
@@ -92,23 +180,42 @@ static bool
 lookup (const struct dir *dir, const char *name,
         struct dir_entry *ep, off_t *ofsp) 
 {
-  struct dir_entry e;
-  size_t ofs;
+  /*Added by moon*/
+  struct dir_header h;
+  struct dir_block *b;
+  uint32_t idx;
+  size_t i;
+  bool found = false;
   
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (e.in_use && !strcmp (name, e.name)) 
-      {
-        if (ep != NULL)
-          *ep = e;
-        if (ofsp != NULL)
-          *ofsp = ofs;
-        return true;
-      }
-  return false;
+  b = malloc (sizeof *b);
+  if (b == NULL || !read_header (dir, &h))
+    goto done;
+
+  /*只查NAME所在的桶和它的溢出块*/
+  for (idx = 1 + bucket_of (&h, name); idx != 0 && !found; idx = b->next)
+    {
+      if (!read_block (dir, idx, b))
+        break;
+      for (i = 0; i < DIR_SLOTS; i++)
+        if (b->entries[i].in_use && !strcmp (name, b->entries[i].name)) 
+          {
+            if (ep != NULL)
+              *ep = b->entries[i];
+            if (ofsp != NULL)
+              *ofsp = (idx * BLOCK_SECTOR_SIZE
+                       + i * sizeof (struct dir_entry));
+            found = true;
+            break;
+          }
+    }
+
+ done:
+  free (b);
+  return found;
+  /*Added by moon*/
 }
 
 /* Searches DIR for a file with the given NAME
@@ -142,8 +249,10 @@ bool
 dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
 {
   struct dir_entry e;
-  off_t ofs;
   bool success = false;
+  /*Added by moon*/
+  struct dir_header h;
+  /*Added by moon*/
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
@@ -156,23 +265,26 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   if (lookup (dir, name, NULL, NULL))
     goto done;
 
-  /* Set OFS to offset of free slot.
-     If there are no free slots, then it will be set to the
-     current end-of-file.
-     
-     inode_read_at() will only return a short read at end of file.
-     Otherwise, we'd need to verify that we didn't get a short
-     read due to something intermittent such as low memory. */
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (!e.in_use)
-      break;
+  /*Added by moon*/
+  if (!read_header (dir, &h))
+    goto done;
+
+  /*太满了就把桶的数量加倍*/
+  if (h.entry_cnt + 1 > h.bucket_cnt * DIR_SLOTS * 3 / 4
+      && !rehash (dir, &h))
+    goto done;
 
   /* Write slot. */
+  memset (&e, 0, sizeof e);
   e.in_use = true;
   strlcpy (e.name, name, sizeof e.name);
   e.inode_sector = inode_sector;
-  success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+  if (!insert (dir, &h, &e))
+    goto done;
+
+  h.entry_cnt++;
+  success = write_header (dir, &h);
+  /*Added by moon*/
 
  done:
   return success;
@@ -188,6 +300,9 @@ dir_remove (struct dir *dir, const char *name)
   struct inode *inode = NULL;
   bool success = false;
   off_t ofs;
+  /*Added by moon*/
+  struct dir_header h;
+  /*Added by moon*/
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
@@ -206,6 +321,14 @@ dir_remove (struct dir *dir, const char *name)
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
     goto done;
 
+  /*Added by moon*/
+  if (read_header (dir, &h))
+    {
+      h.entry_cnt--;
+      write_header (dir, &h);
+    }
+  /*Added by moon*/
+
   /* Remove inode. */
   inode_remove (inode);
   success = true;
@@ -222,10 +345,21 @@ bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
+  /*Added by moon*/
+  struct dir_header h;
+  off_t block_cnt;
 
-  while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
+  /*POS是桶和溢出块中的第几项，跳过头部和每块末尾的next*/
+  if (!read_header (dir, &h))
+    return false;
+  block_cnt = 1 + h.bucket_cnt + h.overflow_cnt;
+  while ((off_t) (1 + dir->pos / DIR_SLOTS) < block_cnt)
     {
-      dir->pos += sizeof e;
+      off_t ofs = ((1 + dir->pos / DIR_SLOTS) * BLOCK_SECTOR_SIZE
+                   + dir->pos % DIR_SLOTS * sizeof e);
+      if (inode_read_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
+        break;
+      dir->pos++;
       if (e.in_use)
         {
           strlcpy (name, e.name, NAME_MAX + 1);
@@ -233,4 +367,187 @@ dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
         } 
     }
   return false;
+  /*Added by moon*/
+}
+
+/*Added by moon*/
+/*读目录的头部*/
+static bool
+read_header (const struct dir *dir, struct dir_header *h)
+{
+  return inode_read_at (dir->inode, h, sizeof *h, 0) == sizeof *h;
+}
+
+/*写目录的头部*/
+static bool
+write_header (struct dir *dir, const struct dir_header *h)
+{
+  return inode_write_at (dir->inode, h, sizeof *h, 0) == sizeof *h;
+}
+
+/*读第IDX块*/
+static bool
+read_block (const struct dir *dir, uint32_t idx, struct dir_block *b)
+{
+  return (inode_read_at (dir->inode, b, sizeof *b, idx * BLOCK_SECTOR_SIZE)
+          == sizeof *b);
+}
+
+/*写第IDX块，必要时扩展目录*/
+static bool
+write_block (struct dir *dir, uint32_t idx, const struct dir_block *b)
+{
+  return (inode_write_at (dir->inode, b, sizeof *b, idx * BLOCK_SECTOR_SIZE)
+          == sizeof *b);
+}
+
+/*返回NAME所在的桶*/
+static uint32_t
+bucket_of (const struct dir_header *h, const char *name)
+{
+  return hash_string (name) & (h->bucket_cnt - 1);
+}
+
+/*把E放到它的桶中第一个空闲的位置，桶和溢出块都满了就在后面加一个溢出块。
+会修改*H的overflow_cnt，但不写回头部*/
+static bool
+insert (struct dir *dir, struct dir_header *h, const struct dir_entry *e)
+{
+  struct dir_block *b;
+  uint32_t idx, new_idx;
+  size_t i;
+  bool success = false;
+
+  b = malloc (sizeof *b);
+  if (b == NULL)
+    return false;
+
+  for (idx = 1 + bucket_of (h, e->name); ; idx = b->next)
+    {
+      if (!read_block (dir, idx, b))
+        goto done;
+      for (i = 0; i < DIR_SLOTS; i++)
+        if (!b->entries[i].in_use)
+          {
+            b->entries[i] = *e;
+            success = write_block (dir, idx, b);
+            goto done;
+          }
+      if (b->next == 0)
+        break;
+    }
+
+  /*先写新的溢出块，再把它接到链上*/
+  new_idx = 1 + h->bucket_cnt + h->overflow_cnt;
+  memset (b, 0, sizeof *b);
+  b->entries[0] = *e;
+  if (!write_block (dir, new_idx, b)
+      || inode_write_at (dir->inode, &new_idx, sizeof new_idx,
+                         (idx * BLOCK_SECTOR_SIZE
+                          + offsetof (struct dir_block, next)))
+         != sizeof new_idx)
+    goto done;
+  h->overflow_cnt++;
+  success = true;
+
+ done:
+  free (b);
+  return success;
+}
+
+/*把桶的数量加倍，重新散列所有的项。先在内存中排好每个桶的项，算出需要多少
+溢出块，把目录扩展到足够长之后才开始改写，所以内存或磁盘空间不够时什么也
+不做，只是溢出块会多一些。返回false表示改写到一半失败了*/
+static bool
+rehash (struct dir *dir, struct dir_header *h)
+{
+  struct dir_entry *entries = NULL;
+  uint32_t *buckets = NULL, *starts = NULL;
+  size_t *order = NULL;
+  struct dir_block *b;
+  uint32_t block_cnt, bucket_cnt, overflow_cnt, idx, k;
+  size_t cnt = 0, i;
+  bool success = true;
+
+  b = calloc (1, sizeof *b);
+  if (b == NULL)
+    return true;
+  bucket_cnt = h->bucket_cnt * 2;
+  entries = malloc (h->entry_cnt * sizeof *entries + 1);
+  buckets = malloc (h->entry_cnt * sizeof *buckets + 1);
+  order = malloc (h->entry_cnt * sizeof *order + 1);
+  starts = calloc (bucket_cnt + 1, sizeof *starts);
+  if (entries == NULL || buckets == NULL || order == NULL || starts == NULL)
+    goto done;
+
+  /*把所有的项读到内存中*/
+  block_cnt = 1 + h->bucket_cnt + h->overflow_cnt;
+  for (idx = 1; idx < block_cnt; idx++)
+    {
+      if (!read_block (dir, idx, b))
+        goto done;
+      for (i = 0; i < DIR_SLOTS; i++)
+        if (b->entries[i].in_use && cnt < h->entry_cnt)
+          entries[cnt++] = b->entries[i];
+    }
+
+  /*按新的桶排序：STARTS[K]是第K个桶的第一项在ORDER中的位置*/
+  for (i = 0; i < cnt; i++)
+    {
+      buckets[i] = hash_string (entries[i].name) & (bucket_cnt - 1);
+      starts[buckets[i] + 1]++;
+    }
+  overflow_cnt = 0;
+  for (k = 0; k < bucket_cnt; k++)
+    {
+      uint32_t n = starts[k + 1];
+      if (n > DIR_SLOTS)
+        overflow_cnt += DIV_ROUND_UP (n, DIR_SLOTS) - 1;
+      starts[k + 1] += starts[k];
+    }
+  for (i = 0; i < cnt; i++)
+    order[starts[buckets[i]]++] = i;
+  for (k = bucket_cnt; k > 0; k--)
+    starts[k] = starts[k - 1];
+  starts[0] = 0;
+
+  /*新的表比原来的长时，先写最后一块来扩展目录，这样磁盘满时还没有改动
+  任何东西；之后的写都在目录的范围内，不用再分配扇区*/
+  memset (b, 0, sizeof *b);
+  if (1 + bucket_cnt + overflow_cnt > block_cnt
+      && !write_block (dir, bucket_cnt + overflow_cnt, b))
+    goto done;
+
+  /*逐个桶写出它的块链，溢出块依次放在桶的后面*/
+  h->bucket_cnt = bucket_cnt;
+  h->overflow_cnt = 0;
+  for (k = 0; k < bucket_cnt && success; k++)
+    {
+      size_t next = starts[k];
+
+      idx = 1 + k;
+      do
+        {
+          memset (b, 0, sizeof *b);
+          for (i = 0; i < DIR_SLOTS && next < starts[k + 1]; i++)
+            b->entries[i] = entries[order[next++]];
+          if (next < starts[k + 1])
+            b->next = 1 + bucket_cnt + h->overflow_cnt++;
+          if (!write_block (dir, idx, b))
+            success = false;
+          idx = b->next;
+        }
+      while (idx != 0 && success);
+    }
+  if (!write_header (dir, h))
+    success = false;
+
+ done:
+  free (starts);
+  free (order);
+  free (buckets);
+  free (entries);
+  free (b);
+  return success;
 }
+/*Added by moon*/
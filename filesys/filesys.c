@@ -2,6 +2,9 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+/*Added by moon*/
+#include "filesys/cache.h"
+/*Added by moon*/
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
@@ -21,6 +24,9 @@ filesys_init (bool format)
   if (fs_device == NULL)
     PANIC ("No file system device found, can't initialize file system.");
 
+  /*Added by moon*/
+  cache_init ();
+  /*Added by moon*/
   inode_init ();
   free_map_init ();
 
@@ -36,6 +42,10 @@ void
 filesys_done (void) 
 {
   free_map_close ();
+  /*Added by moon*/
+  /*写回缓冲区缓存中所有的脏扇区*/
+  cache_flush ();
+  /*Added by moon*/
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
@@ -47,8 +57,13 @@ filesys_create (const char *name, off_t initial_size)
 {
   block_sector_t inode_sector = 0;
   struct dir *dir = dir_open_root ();
+  /*Added by moon*/
+  /*inode尽量放在目录的inode附近*/
+  block_sector_t hint = (dir != NULL
+                         ? inode_get_inumber (dir_get_inode (dir)) + 1 : 0);
+  /*Added by moon*/
   bool success = (dir != NULL
-                  && free_map_allocate (1, &inode_sector)
+                  && free_map_allocate_near (1, hint, &inode_sector)
                   && inode_create (inode_sector, initial_size)
                   && dir_add (dir, name, inode_sector));
   if (!success && inode_sector != 0) 
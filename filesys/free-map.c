@@ -1,22 +1,131 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+/*Added by moon*/
+#include <hash.h>
+#include <list.h>
+/*Added by moon*/
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+/*Added by moon*/
+#include "filesys/cache.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+/*Added by moon*/
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
 
+/*Added by moon*/
+/* Free map persistence.
+
+   Allocating or releasing sectors changes the in-memory free
+   map and copies just the sectors of the free map file that hold
+   the changed bits into the buffer cache.  They reach the disk
+   with the rest of the cache, at sync points: periodically from
+   the flusher thread, when an allocation fails, and when the
+   file system is shut down.
+
+   The free map file is written with cache_write_first(), so the
+   cache writes its dirty sectors before any other sector, even
+   when it evicts an inode or index sector between sync points.
+   A sector is therefore marked in use on disk before anything
+   that refers to it.  Released sectors are not reused right
+   away: they stay allocated until free_map_flush() has written
+   the metadata that stopped referring to them.  A crash can leak
+   sectors but never leaves two files sharing one. */
+
+/* Sectors released since the last flush. */
+struct pending_free
+  {
+    block_sector_t sector;      /* First sector. */
+    size_t cnt;                 /* Number of sectors. */
+    struct list_elem elem;      /* Element in pending_frees. */
+  };
+static struct list pending_frees;
+
+/*保护空闲位图、区段索引和上面的状态。回写线程和文件系统的使用者会同时
+访问它们*/
+static struct lock free_map_lock;
+
+static bool allocate (size_t cnt, block_sector_t hint,
+                      block_sector_t *sectorp);
+static void release (block_sector_t sector, size_t cnt);
+static void write_map (block_sector_t sector, size_t cnt);
+static void flush (void);
+/*Added by moon*/
+
+/*Added by moon*/
+/* Free extents.
+
+   The bitmap is what is stored on disk, but allocation works
+   from an index of the free extents, i.e. maximal runs of free
+   sectors, which is rebuilt from the bitmap whenever the bitmap
+   is read.  Each extent is on the free list for its size class
+   and in two hash tables, keyed by its first sector and by the
+   sector just past its end, so that a released run is merged
+   with its free neighbours in constant time and an allocation
+   hinted to start right after a file's last sector finds the
+   extent that starts there in constant time. */
+
+/*按照长度分类的链表数，第K类的长度在[2**K, 2**(K+1))之间*/
+#define SIZE_CLASS_CNT 32
+
+/*按位置提示分配时，在提示的扇区之后检查多少个扇区作为区段的起点*/
+#define NEAR_SCAN 32
+
+/* A run of free sectors. */
+struct extent
+  {
+    block_sector_t start;       /* First sector. */
+    size_t cnt;                 /* Number of sectors. */
+    struct list_elem size_elem; /* Element in size class list. */
+    struct hash_elem start_elem; /* Element in extents_by_start. */
+    struct hash_elem end_elem;  /* Element in extents_by_end. */
+  };
+
+static struct list size_classes[SIZE_CLASS_CNT];
+static struct hash extents_by_start;
+static struct hash extents_by_end;
+
+static void build_extents (void);
+static void clear_extents (void);
+static void add_extent (block_sector_t start, size_t cnt);
+static void insert_extent (struct extent *);
+static void remove_extent (struct extent *);
+static struct extent *find_by_start (block_sector_t);
+static struct extent *find_by_end (block_sector_t);
+static struct extent *find_fit (size_t cnt);
+static int size_class (size_t cnt);
+static hash_hash_func start_hash, end_hash;
+static hash_less_func start_less, end_less;
+/*Added by moon*/
+
 /* Initializes the free map. */
 void
 free_map_init (void) 
 {
+  /*Added by moon*/
+  int i;
+  /*Added by moon*/
+
   free_map = bitmap_create (block_size (fs_device));
   if (free_map == NULL)
     PANIC ("bitmap creation failed--file system device is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+
+  /*Added by moon*/
+  list_init (&pending_frees);
+  lock_init (&free_map_lock);
+  for (i = 0; i < SIZE_CLASS_CNT; i++)
+    list_init (&size_classes[i]);
+  if (!hash_init (&extents_by_start, start_hash, start_less, NULL)
+      || !hash_init (&extents_by_end, end_hash, end_less, NULL))
+    PANIC ("free map extent index creation failed");
+  build_extents ();
+  /*Added by moon*/
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -27,27 +136,80 @@ free_map_init (void)
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+  /*Added by moon*/
+  return free_map_allocate_near (cnt, 0, sectorp);
+  /*Added by moon*/
+}
+
+/*Added by moon*/
+/* Like free_map_allocate(), but prefers a large enough free
+   extent that starts at HINT or shortly after it, and otherwise
+   the smallest free extent that is large enough.  A HINT of 0
+   means no preference.  Passing the sector just past a file's
+   last sector as HINT keeps files that grow incrementally
+   contiguous on disk. */
+bool
+free_map_allocate_near (size_t cnt, block_sector_t hint,
+                        block_sector_t *sectorp)
+{
+  bool success;
+
+  lock_acquire (&free_map_lock);
+  success = allocate (cnt, hint, sectorp);
+  if (!success && !list_empty (&pending_frees))
     {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
+      /*刚释放的扇区要写回之后才能重新使用，现在就写回，然后再试一次*/
+      flush ();
+      success = allocate (cnt, hint, sectorp);
     }
-  if (sector != BITMAP_ERROR)
-    *sectorp = sector;
-  return sector != BITMAP_ERROR;
+  lock_release (&free_map_lock);
+  return success;
 }
+/*Added by moon*/
 
-/* Makes CNT sectors starting at SECTOR available for use. */
+/* Makes CNT sectors starting at SECTOR available for use.
+   They become available for allocation after the next call to
+   free_map_flush(). */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
+  /*Added by moon*/
+  struct pending_free *p;
+
   ASSERT (bitmap_all (free_map, sector, cnt));
-  bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  p = malloc (sizeof *p);
+  lock_acquire (&free_map_lock);
+  if (p != NULL)
+    {
+      p->sector = sector;
+      p->cnt = cnt;
+      list_push_back (&pending_frees, &p->elem);
+    }
+  else
+    {
+      /*没有内存记下来就只好马上释放*/
+      release (sector, cnt);
+    }
+  lock_release (&free_map_lock);
+  /*Added by moon*/
+}
+
+/*Added by moon*/
+/* Writes the buffer cache, including the changed parts of the
+   free map, to disk, and then makes the sectors released since
+   the last flush available for allocation. */
+void
+free_map_flush (void)
+{
+  /*空闲位图文件还没有打开，或者已经关闭*/
+  if (free_map_file == NULL)
+    return;
+
+  lock_acquire (&free_map_lock);
+  flush ();
+  lock_release (&free_map_lock);
 }
+/*Added by moon*/
 
 /* Opens the free map file and reads it from disk. */
 void
@@ -56,15 +218,29 @@ free_map_open (void)
   free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
   if (free_map_file == NULL)
     PANIC ("can't open free map");
+  /*Added by moon*/
+  inode_set_write_first (file_get_inode (free_map_file));
+  /*Added by moon*/
   if (!bitmap_read (free_map, free_map_file))
     PANIC ("can't read free map");
+  /*Added by moon*/
+  build_extents ();
+  /*Added by moon*/
 }
 
 /* Writes the free map to disk and closes the free map file. */
 void
 free_map_close (void) 
 {
+  /*Added by moon*/
+  /*刷两次：第一次之后才释放的扇区要在第二次写回*/
+  free_map_flush ();
+  free_map_flush ();
+  lock_acquire (&free_map_lock);
   file_close (free_map_file);
+  free_map_file = NULL;
+  lock_release (&free_map_lock);
+  /*Added by moon*/
 }
 
 /* Creates a new free map file on disk and writes the free map to
@@ -80,6 +256,284 @@ free_map_create (void)
   free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
   if (free_map_file == NULL)
     PANIC ("can't open free map");
+  /*Added by moon*/
+  inode_set_write_first (file_get_inode (free_map_file));
+  /*Added by moon*/
   if (!bitmap_write (free_map, free_map_file))
     PANIC ("can't write free map");
 }
+
+/*Added by moon*/
+/*从区段索引中分配CNT个连续的扇区，见free_map_allocate_near()。
+必须持有free_map_lock*/
+static bool
+allocate (size_t cnt, block_sector_t hint, block_sector_t *sectorp)
+{
+  struct extent *e = NULL;
+  block_sector_t sector;
+  size_t i;
+
+  if (cnt == 0)
+    return false;
+
+  for (i = 0; hint != 0 && e == NULL && i < NEAR_SCAN; i++)
+    {
+      e = find_by_start (hint + i);
+      if (e != NULL && e->cnt < cnt)
+        e = NULL;
+    }
+  if (e == NULL)
+    e = find_fit (cnt);
+  if (e == NULL)
+    return false;
+
+  /*从区段的开头分配，剩下的部分换到新的长度类中*/
+  sector = e->start;
+  remove_extent (e);
+  if (e->cnt > cnt)
+    {
+      e->start += cnt;
+      e->cnt -= cnt;
+      insert_extent (e);
+    }
+  else
+    free (e);
+
+  ASSERT (!bitmap_any (free_map, sector, cnt));
+  bitmap_set_multiple (free_map, sector, cnt, true);
+  write_map (sector, cnt);
+  *sectorp = sector;
+  return true;
+}
+
+/*马上把从SECTOR开始的CNT个扇区标记为空闲，可以再分配。
+必须持有free_map_lock*/
+static void
+release (block_sector_t sector, size_t cnt)
+{
+  ASSERT (bitmap_all (free_map, sector, cnt));
+  bitmap_set_multiple (free_map, sector, cnt, false);
+  add_extent (sector, cnt);
+  write_map (sector, cnt);
+}
+
+/*把空闲位图文件中存放从SECTOR开始的CNT个扇区的位的那些扇区复制到
+缓冲区缓存中。空闲位图文件还没有建立时什么也不做，建立时会写入整个位图。
+必须持有free_map_lock*/
+static void
+write_map (block_sector_t sector, size_t cnt)
+{
+  size_t bits_per_sector = BLOCK_SECTOR_SIZE * 8;
+  size_t first = sector / bits_per_sector;
+  size_t last = (sector + cnt - 1) / bits_per_sector;
+
+  if (free_map_file != NULL)
+    bitmap_write_part (free_map, free_map_file, first * BLOCK_SECTOR_SIZE,
+                       (last - first + 1) * BLOCK_SECTOR_SIZE);
+}
+
+/*见free_map_flush()。必须持有free_map_lock。
+
+写回整个缓冲区缓存之后才让等待释放的扇区可以再分配，这时不再引用它们的
+inode和目录已经在磁盘上了。新分配的扇区不用在这里处理，缓存总是先写回
+空闲位图*/
+static void
+flush (void)
+{
+  cache_flush ();
+
+  while (!list_empty (&pending_frees))
+    {
+      struct pending_free *p = list_entry (list_pop_front (&pending_frees),
+                                           struct pending_free, elem);
+      release (p->sector, p->cnt);
+      free (p);
+    }
+}
+
+/*丢弃原来的区段索引，从位图重新建立*/
+static void
+build_extents (void)
+{
+  size_t sector_cnt = bitmap_size (free_map);
+  size_t start = 0;
+
+  clear_extents ();
+  while (start < sector_cnt)
+    {
+      size_t end;
+
+      start = bitmap_scan (free_map, start, 1, false);
+      if (start == BITMAP_ERROR)
+        break;
+      end = bitmap_scan (free_map, start, 1, true);
+      if (end == BITMAP_ERROR)
+        end = sector_cnt;
+      add_extent (start, end - start);
+      start = end;
+    }
+}
+
+/*释放所有的区段*/
+static void
+clear_extents (void)
+{
+  int i;
+
+  for (i = 0; i < SIZE_CLASS_CNT; i++)
+    while (!list_empty (&size_classes[i]))
+      {
+        struct extent *e = list_entry (list_front (&size_classes[i]),
+                                       struct extent, size_elem);
+        remove_extent (e);
+        free (e);
+      }
+}
+
+/*把从START开始的CNT个空闲扇区加入索引，和前后相邻的空闲区段合并。
+内存不足时这些扇区暂时不能分配，直到下次从位图重建索引*/
+static void
+add_extent (block_sector_t start, size_t cnt)
+{
+  struct extent *prev = find_by_end (start);
+  struct extent *next = find_by_start (start + cnt);
+
+  if (prev != NULL)
+    {
+      remove_extent (prev);
+      prev->cnt += cnt;
+      if (next != NULL)
+        {
+          remove_extent (next);
+          prev->cnt += next->cnt;
+          free (next);
+        }
+      insert_extent (prev);
+    }
+  else if (next != NULL)
+    {
+      remove_extent (next);
+      next->start = start;
+      next->cnt += cnt;
+      insert_extent (next);
+    }
+  else
+    {
+      struct extent *e = malloc (sizeof *e);
+      if (e == NULL)
+        return;
+      e->start = start;
+      e->cnt = cnt;
+      insert_extent (e);
+    }
+}
+
+/*把区段E加入索引*/
+static void
+insert_extent (struct extent *e)
+{
+  list_push_front (&size_classes[size_class (e->cnt)], &e->size_elem);
+  hash_insert (&extents_by_start, &e->start_elem);
+  hash_insert (&extents_by_end, &e->end_elem);
+}
+
+/*把区段E从索引中取下，不释放它*/
+static void
+remove_extent (struct extent *e)
+{
+  list_remove (&e->size_elem);
+  hash_delete (&extents_by_start, &e->start_elem);
+  hash_delete (&extents_by_end, &e->end_elem);
+}
+
+/*返回从SECTOR开始的空闲区段，没有时返回NULL*/
+static struct extent *
+find_by_start (block_sector_t sector)
+{
+  struct extent key;
+  struct hash_elem *e;
+
+  key.start = sector;
+  e = hash_find (&extents_by_start, &key.start_elem);
+  return e != NULL ? hash_entry (e, struct extent, start_elem) : NULL;
+}
+
+/*返回在SECTOR之前结束的空闲区段，没有时返回NULL*/
+static struct extent *
+find_by_end (block_sector_t sector)
+{
+  struct extent key;
+  struct hash_elem *e;
+
+  key.start = sector;
+  key.cnt = 0;
+  e = hash_find (&extents_by_end, &key.end_elem);
+  return e != NULL ? hash_entry (e, struct extent, end_elem) : NULL;
+}
+
+/*返回能容纳CNT个扇区的最小长度类中的一个区段，没有时返回NULL。
+CNT所在的长度类中的区段不一定都够长，要逐个检查；更高的长度类中的
+任何一个都够长*/
+static struct extent *
+find_fit (size_t cnt)
+{
+  int k = size_class (cnt);
+  struct list_elem *le;
+
+  for (le = list_begin (&size_classes[k]); le != list_end (&size_classes[k]);
+       le = list_next (le))
+    {
+      struct extent *e = list_entry (le, struct extent, size_elem);
+      if (e->cnt >= cnt)
+        return e;
+    }
+  for (k++; k < SIZE_CLASS_CNT; k++)
+    if (!list_empty (&size_classes[k]))
+      return list_entry (list_front (&size_classes[k]),
+                         struct extent, size_elem);
+  return NULL;
+}
+
+/*CNT个扇区所属的长度类，即CNT以2为底的对数的整数部分*/
+static int
+size_class (size_t cnt)
+{
+  int k = 0;
+
+  ASSERT (cnt > 0);
+  while (k + 1 < SIZE_CLASS_CNT && cnt >> (k + 1) != 0)
+    k++;
+  return k;
+}
+
+static unsigned
+start_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct extent, start_elem)->start);
+}
+
+static bool
+start_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct extent, start_elem)->start
+          < hash_entry (b, struct extent, start_elem)->start);
+}
+
+/*按照区段之后的第一个扇区散列*/
+static unsigned
+end_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct extent *x = hash_entry (e, struct extent, end_elem);
+  return hash_int (x->start + x->cnt);
+}
+
+static bool
+end_less (const struct hash_elem *a, const struct hash_elem *b,
+          void *aux UNUSED)
+{
+  const struct extent *x = hash_entry (a, struct extent, end_elem);
+  const struct extent *y = hash_entry (b, struct extent, end_elem);
+  return x->start + x->cnt < y->start + y->cnt;
+}
+/*Added by moon*/
@@ -12,6 +12,12 @@ void free_map_open (void);
 void free_map_close (void);
 
 bool free_map_allocate (size_t, block_sector_t *);
+/*Added by moon*/
+bool free_map_allocate_near (size_t, block_sector_t hint, block_sector_t *);
+/*Added by moon*/
 void free_map_release (block_sector_t, size_t);
+/*Added by moon*/
+void free_map_flush (void);
+/*Added by moon*/
 
 #endif /* filesys/free-map.h */
@@ -3,21 +3,46 @@
 #include <debug.h>
 #include <round.h>
 #include <string.h>
+/*Added by moon*/
+#include "filesys/cache.h"
+/*Added by moon*/
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+/*Added by moon*/
+#include "threads/synch.h"
+/*Added by moon*/
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/*Added by moon*/
+/* Data sectors are found through a multi-level index: the
+   inode holds DIRECT_CNT direct sector numbers, then the number
+   of an indirect sector holding PTRS_PER_SECTOR more, then the
+   number of a doubly indirect sector holding PTRS_PER_SECTOR
+   indirect sectors.  Sector 0 holds the free map inode, so a
+   sector number of 0 means "not allocated".  Sectors are
+   allocated one at a time as the file grows, so a file need not
+   be contiguous on disk. */
+#define DIRECT_CNT 124
+#define PTRS_PER_SECTOR (BLOCK_SECTOR_SIZE / sizeof (block_sector_t))
+
+/*扩展文件时一次最多分配的连续扇区数*/
+#define GROW_BATCH 64
+/*Added by moon*/
+
 /* On-disk inode.
    Must be exactly BLOCK_SECTOR_SIZE bytes long. */
 struct inode_disk
   {
-    block_sector_t start;               /* First data sector. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
+    /*Added by moon*/
+    block_sector_t direct[DIRECT_CNT];  /* Direct data sectors. */
+    block_sector_t indirect;            /* Indirect index sector. */
+    block_sector_t doubly_indirect;     /* Doubly indirect index sector. */
+    /*Added by moon*/
   };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -36,9 +61,20 @@ struct inode
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    /*Added by moon*/
+    struct lock grow_lock;              /* Serializes growth. */
+    bool write_first;                   /* Data reaches disk first? */
+    /*Added by moon*/
     struct inode_disk data;             /* Inode content. */
   };
 
+/*Added by moon*/
+static block_sector_t index_lookup (const struct inode_disk *, size_t idx);
+static off_t grow (struct inode_disk *, off_t length,
+                   block_sector_t inode_sector);
+static void deallocate (struct inode_disk *);
+/*Added by moon*/
+
 /* Returns the block device sector that contains byte offset POS
    within INODE.
    Returns -1 if INODE does not contain data for a byte at offset
@@ -47,10 +83,13 @@ static block_sector_t
 byte_to_sector (const struct inode *inode, off_t pos) 
 {
   ASSERT (inode != NULL);
+  /*Added by moon*/
+  /*最多经过两级索引扇区，它们通常都在缓冲区缓存中*/
   if (pos < inode->data.length)
-    return inode->data.start + pos / BLOCK_SECTOR_SIZE;
+    return index_lookup (&inode->data, pos / BLOCK_SECTOR_SIZE);
   else
     return -1;
+  /*Added by moon*/
 }
 
 /* List of open inodes, so that opening a single inode twice
@@ -84,22 +123,19 @@ inode_create (block_sector_t sector, off_t length)
   disk_inode = calloc (1, sizeof *disk_inode);
   if (disk_inode != NULL)
     {
-      size_t sectors = bytes_to_sectors (length);
-      disk_inode->length = length;
+      disk_inode->length = 0;
       disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start)) 
+      /*Added by moon*/
+      /*数据扇区逐个分配并清零，不需要连续的空闲空间*/
+      if (grow (disk_inode, length, sector) == length)
         {
-          block_write (fs_device, sector, disk_inode);
-          if (sectors > 0) 
-            {
-              static char zeros[BLOCK_SECTOR_SIZE];
-              size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                block_write (fs_device, disk_inode->start + i, zeros);
-            }
+          disk_inode->length = length;
+          cache_write (sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
           success = true; 
         } 
+      else
+        deallocate (disk_inode);
+      /*Added by moon*/
       free (disk_inode);
     }
   return success;
@@ -137,7 +173,13 @@ inode_open (block_sector_t sector)
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
+  /*Added by moon*/
+  lock_init (&inode->grow_lock);
+  inode->write_first = false;
+  /*Added by moon*/
+  /*Added by moon*/
+  cache_read (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+  /*Added by moon*/
   return inode;
 }
 
@@ -177,8 +219,9 @@ inode_close (struct inode *inode)
       if (inode->removed) 
         {
           free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
+          /*Added by moon*/
+          deallocate (&inode->data);
+          /*Added by moon*/
         }
 
       free (inode); 
@@ -194,6 +237,185 @@ inode_remove (struct inode *inode)
   inode->removed = true;
 }
 
+/*Added by moon*/
+/*分配一个清零的扇区，存到*SECTORP中。磁盘满时返回false*/
+static bool
+alloc_zeroed (block_sector_t *sectorp)
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+
+  if (!free_map_allocate (1, sectorp))
+    return false;
+  cache_write (*sectorp, zeros, 0, BLOCK_SECTOR_SIZE);
+  return true;
+}
+
+/*返回索引扇区TABLE中的第I项，TABLE为0时返回0*/
+static block_sector_t
+read_entry (block_sector_t table, size_t i)
+{
+  block_sector_t sector = 0;
+
+  if (table != 0)
+    cache_read (table, &sector, i * sizeof sector, sizeof sector);
+  return sector;
+}
+
+/*把索引扇区TABLE中的第I项设为SECTOR*/
+static void
+write_entry (block_sector_t table, size_t i, block_sector_t sector)
+{
+  cache_write (table, &sector, i * sizeof sector, sizeof sector);
+}
+
+/*确保*TABLEP指向一个索引扇区，没有时分配一个清零的。磁盘满时返回false*/
+static bool
+ensure_table (block_sector_t *tablep)
+{
+  return *tablep != 0 || alloc_zeroed (tablep);
+}
+
+/*返回D的第IDX个数据扇区，还没有分配时返回0*/
+static block_sector_t
+index_lookup (const struct inode_disk *d, size_t idx)
+{
+  if (idx < DIRECT_CNT)
+    return d->direct[idx];
+  idx -= DIRECT_CNT;
+
+  if (idx < PTRS_PER_SECTOR)
+    return read_entry (d->indirect, idx);
+  idx -= PTRS_PER_SECTOR;
+
+  if (idx < PTRS_PER_SECTOR * PTRS_PER_SECTOR)
+    return read_entry (read_entry (d->doubly_indirect, idx / PTRS_PER_SECTOR),
+                       idx % PTRS_PER_SECTOR);
+
+  return 0;
+}
+
+/*把D的第IDX个数据扇区设为SECTOR，缺少的索引扇区在这里分配。D中的指针
+可能会被修改，调用者要把D写回磁盘。超过最大文件长度或者磁盘满时返回
+false*/
+static bool
+index_set (struct inode_disk *d, size_t idx, block_sector_t sector)
+{
+  block_sector_t table;
+
+  if (idx < DIRECT_CNT)
+    {
+      d->direct[idx] = sector;
+      return true;
+    }
+  idx -= DIRECT_CNT;
+
+  if (idx < PTRS_PER_SECTOR)
+    {
+      if (!ensure_table (&d->indirect))
+        return false;
+      write_entry (d->indirect, idx, sector);
+      return true;
+    }
+  idx -= PTRS_PER_SECTOR;
+
+  if (idx < PTRS_PER_SECTOR * PTRS_PER_SECTOR)
+    {
+      if (!ensure_table (&d->doubly_indirect))
+        return false;
+      table = read_entry (d->doubly_indirect, idx / PTRS_PER_SECTOR);
+      if (table == 0)
+        {
+          if (!alloc_zeroed (&table))
+            return false;
+          write_entry (d->doubly_indirect, idx / PTRS_PER_SECTOR, table);
+        }
+      write_entry (table, idx % PTRS_PER_SECTOR, sector);
+      return true;
+    }
+
+  /*超过了最大的文件长度*/
+  return false;
+}
+
+/*为D分配数据扇区，直到它可以容纳LENGTH字节，返回能达到的长度。
+磁盘满时返回的长度小于LENGTH，但不会小于D原来的长度。不修改D的长度。
+
+需要的扇区一次成批分配，尽量接在文件最后一个数据扇区之后，文件是空的
+时候接在inode所在的扇区INODE_SECTOR之后，这样逐渐写大的文件在磁盘上
+也大多是连续的。找不到足够长的连续空闲区段时每次减半*/
+static off_t
+grow (struct inode_disk *d, off_t length, block_sector_t inode_sector)
+{
+  size_t idx = bytes_to_sectors (d->length);
+  size_t end = bytes_to_sectors (length);
+  block_sector_t hint = inode_sector + 1;
+
+  if (idx > 0 && index_lookup (d, idx - 1) != 0)
+    hint = index_lookup (d, idx - 1) + 1;
+
+  while (idx < end)
+    {
+      static char zeros[BLOCK_SECTOR_SIZE];
+      size_t cnt = end - idx < GROW_BATCH ? end - idx : GROW_BATCH;
+      block_sector_t start;
+      size_t i;
+
+      while (!free_map_allocate_near (cnt, hint, &start))
+        if ((cnt /= 2) == 0)
+          return idx * BLOCK_SECTOR_SIZE;
+
+      for (i = 0; i < cnt; i++)
+        {
+          cache_write (start + i, zeros, 0, BLOCK_SECTOR_SIZE);
+          if (!index_set (d, idx, start + i))
+            {
+              free_map_release (start + i, cnt - i);
+              return idx * BLOCK_SECTOR_SIZE;
+            }
+          idx++;
+        }
+      hint = start + cnt;
+    }
+  return length;
+}
+
+/*释放索引扇区TABLE和它指向的所有扇区。LEVEL是TABLE之下还有几级索引，
+0表示TABLE本身就是数据扇区*/
+static void
+release_table (block_sector_t table, int level)
+{
+  block_sector_t *entries;
+  size_t i;
+
+  if (table == 0)
+    return;
+  if (level > 0)
+    {
+      entries = malloc (BLOCK_SECTOR_SIZE);
+      if (entries != NULL)
+        {
+          cache_read (table, entries, 0, BLOCK_SECTOR_SIZE);
+          for (i = 0; i < PTRS_PER_SECTOR; i++)
+            release_table (entries[i], level - 1);
+          free (entries);
+        }
+    }
+  free_map_release (table, 1);
+}
+
+/*释放D的所有数据扇区和索引扇区*/
+static void
+deallocate (struct inode_disk *d)
+{
+  size_t i;
+
+  for (i = 0; i < DIRECT_CNT; i++)
+    release_table (d->direct[i], 0);
+  release_table (d->indirect, 1);
+  release_table (d->doubly_indirect, 2);
+}
+/*Added by moon*/
+
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
@@ -202,7 +424,9 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
+  /*Added by moon*/
+  block_sector_t next;
+  /*Added by moon*/
 
   while (size > 0) 
     {
@@ -220,51 +444,57 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
-        }
-      else 
-        {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-          block_read (fs_device, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-        }
+      /*Added by moon*/
+      /*经过缓冲区缓存读，不再需要临时缓冲区*/
+      cache_read (sector_idx, buffer + bytes_read, sector_ofs, chunk_size);
+      /*Added by moon*/
       
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_read += chunk_size;
     }
-  free (bounce);
+
+  /*Added by moon*/
+  /*顺序读文件时下一次多半会读紧接着的扇区，让预读线程先把它读进缓存*/
+  next = byte_to_sector (inode, ROUND_UP (offset, BLOCK_SECTOR_SIZE));
+  if (bytes_read > 0 && next != (block_sector_t) -1)
+    cache_read_ahead (next);
+  /*Added by moon*/
 
   return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   less than SIZE if the disk fills up or an error occurs.
+   A write past end of file extends the inode. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 off_t offset) 
 {
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
 
   if (inode->deny_write_cnt)
     return 0;
 
+  /*Added by moon*/
+  /*写到文件末尾之后时先扩展文件，新的扇区在这时才分配。磁盘满了的话
+  只扩展到能分配到的地方，写入的字节数相应减少*/
+  if (offset + size > inode->data.length)
+    {
+      lock_acquire (&inode->grow_lock);
+      if (offset + size > inode->data.length)
+        {
+          inode->data.length = grow (&inode->data, offset + size,
+                                     inode->sector);
+          cache_write (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+        }
+      lock_release (&inode->grow_lock);
+    }
+  /*Added by moon*/
+
   while (size > 0) 
     {
       /* Sector to write, starting byte offset within sector. */
@@ -281,38 +511,21 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
-        }
-      else 
-        {
-          /* We need a bounce buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left) 
-            block_read (fs_device, sector_idx, bounce);
-          else
-            memset (bounce, 0, BLOCK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
-        }
+      /*Added by moon*/
+      /*写到缓冲区缓存中，只写扇区的一部分时缓存会先读入整个扇区*/
+      if (inode->write_first)
+        cache_write_first (sector_idx, buffer + bytes_written, sector_ofs,
+                           chunk_size);
+      else
+        cache_write (sector_idx, buffer + bytes_written, sector_ofs,
+                     chunk_size);
+      /*Added by moon*/
 
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_written += chunk_size;
     }
-  free (bounce);
 
   return bytes_written;
 }
@@ -337,6 +550,18 @@ inode_allow_write (struct inode *inode)
   inode->deny_write_cnt--;
 }
 
+/*Added by moon*/
+/* Makes writes to INODE's data reach the disk before any sector
+   written with plain cache_write(), as cache_write_first() does.
+   The free map uses this so that a sector is marked in use on
+   disk before anything that refers to it. */
+void
+inode_set_write_first (struct inode *inode)
+{
+  inode->write_first = true;
+}
+/*Added by moon*/
+
 /* Returns the length, in bytes, of INODE's data. */
 off_t
 inode_length (const struct inode *inode)
@@ -19,5 +19,8 @@ off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
+/*Added by moon*/
+void inode_set_write_first (struct inode *);
+/*Added by moon*/
 
 #endif /* filesys/inode.h */
@@ -359,6 +359,25 @@ bitmap_write (const struct bitmap *b, struct file *file)
   off_t size = byte_cnt (b->bit_cnt);
   return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/*Added by moon*/
+/* Writes the SIZE bytes of B's file representation that start
+   at byte offset OFS to the same place in FILE, clipped to the
+   size of B.  Returns true if successful, false otherwise. */
+bool
+bitmap_write_part (const struct bitmap *b, struct file *file, off_t ofs,
+                   off_t size)
+{
+  off_t file_size = byte_cnt (b->bit_cnt);
+
+  ASSERT (ofs >= 0 && size >= 0);
+  if (ofs >= file_size)
+    return true;
+  if (size > file_size - ofs)
+    size = file_size - ofs;
+  return file_write_at (file, (uint8_t *) b->bits + ofs, size, ofs) == size;
+}
+/*Added by moon*/
 #endif /* FILESYS */
 
 /* Debugging. */
@@ -0,0 +1,171 @@
+#include "heap.h"
+#include "../debug.h"
+
+/* Pairing heap, see heap.h for an overview.
+
+   Each element keeps its children in a doubly linked list whose
+   first element's `prev' points back to the parent, which lets
+   an arbitrary element be cut out of the tree in O(1) time.
+   Every child is "not less" than its parent, so the root is the
+   front of the heap. */
+
+static struct heap_elem *meld (struct heap *,
+                               struct heap_elem *, struct heap_elem *);
+static struct heap_elem *merge_pairs (struct heap *, struct heap_elem *);
+
+/* Initializes HEAP as an empty heap ordered by LESS given
+   auxiliary data AUX. */
+void
+heap_init (struct heap *heap, heap_less_func *less, void *aux)
+{
+  ASSERT (heap != NULL);
+  ASSERT (less != NULL);
+
+  heap->root = NULL;
+  heap->less = less;
+  heap->aux = aux;
+}
+
+/* Returns true if HEAP is empty, false otherwise. */
+bool
+heap_empty (const struct heap *heap)
+{
+  return heap->root == NULL;
+}
+
+/* Returns the front element of HEAP, that is, an element that no
+   other element is less than.  Undefined behavior if HEAP is
+   empty. */
+struct heap_elem *
+heap_front (const struct heap *heap)
+{
+  ASSERT (!heap_empty (heap));
+  return heap->root;
+}
+
+/* Inserts ELEM into HEAP. */
+void
+heap_insert (struct heap *heap, struct heap_elem *elem)
+{
+  ASSERT (heap != NULL);
+  ASSERT (elem != NULL);
+
+  elem->child = elem->next = elem->prev = NULL;
+  heap->root = meld (heap, heap->root, elem);
+}
+
+/* Removes the front element of HEAP and returns it.  Undefined
+   behavior if HEAP is empty. */
+struct heap_elem *
+heap_pop_front (struct heap *heap)
+{
+  struct heap_elem *front = heap_front (heap);
+
+  heap->root = merge_pairs (heap, front->child);
+  if (heap->root != NULL)
+    heap->root->prev = NULL;
+  return front;
+}
+
+/* Removes ELEM, which must be in HEAP, from HEAP. */
+void
+heap_remove (struct heap *heap, struct heap_elem *elem)
+{
+  struct heap_elem *sub;
+
+  ASSERT (heap != NULL);
+  ASSERT (elem != NULL);
+
+  if (elem == heap->root)
+    {
+      heap_pop_front (heap);
+      return;
+    }
+
+  /* Cut ELEM out of its parent's list of children. */
+  ASSERT (elem->prev != NULL);
+  if (elem->prev->child == elem)
+    elem->prev->child = elem->next;
+  else
+    elem->prev->next = elem->next;
+  if (elem->next != NULL)
+    elem->next->prev = elem->prev;
+
+  /* Merge its children back into the heap. */
+  sub = merge_pairs (heap, elem->child);
+  if (sub != NULL)
+    {
+      sub->prev = NULL;
+      heap->root = meld (heap, heap->root, sub);
+    }
+}
+
+/* Melds the trees rooted at A and B, either of which may be
+   null, and returns the root of the result.  The root that is
+   not less than the other becomes the leftmost child of the
+   other.  The returned root's `next' and `prev' are not
+   meaningful. */
+static struct heap_elem *
+meld (struct heap *heap, struct heap_elem *a, struct heap_elem *b)
+{
+  if (a == NULL)
+    return b;
+  if (b == NULL)
+    return a;
+
+  if (heap->less (b, a, heap->aux))
+    {
+      struct heap_elem *t = a;
+      a = b;
+      b = t;
+    }
+
+  b->prev = a;
+  b->next = a->child;
+  if (a->child != NULL)
+    a->child->prev = b;
+  a->child = b;
+  return a;
+}
+
+/* Melds the list of sibling trees starting at FIRST into a
+   single tree, using the standard two-pass method: meld the
+   trees in pairs from left to right, then meld the pairs from
+   right to left.  Returns the root of the result, or null if
+   FIRST is null. */
+static struct heap_elem *
+merge_pairs (struct heap *heap, struct heap_elem *first)
+{
+  struct heap_elem *pairs = NULL;
+  struct heap_elem *result;
+
+  /* First pass.  The melded pairs are chained through `next' in
+     reverse order. */
+  while (first != NULL)
+    {
+      struct heap_elem *a = first;
+      struct heap_elem *b = a->next;
+      struct heap_elem *pair;
+
+      first = b != NULL ? b->next : NULL;
+      a->next = a->prev = NULL;
+      if (b != NULL)
+        b->next = b->prev = NULL;
+
+      pair = meld (heap, a, b);
+      pair->next = pairs;
+      pairs = pair;
+    }
+
+  /* Second pass. */
+  result = NULL;
+  while (pairs != NULL)
+    {
+      struct heap_elem *pair = pairs;
+
+      pairs = pair->next;
+      pair->next = NULL;
+      result = meld (heap, result, pair);
+    }
+  return result;
+}
@@ -0,0 +1,129 @@
+/* Checks that readers share a readers-writer lock.  Five reader
+   threads acquire the lock and sleep while holding it; all of
+   them must hold it at the same time.
+
+   Then a mix of readers and writers hammers the lock.  Each
+   writer updates two variables with a yield in between, and
+   readers check that they never see the two disagree. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define READER_CNT 5
+#define STRESS_READERS 4
+#define STRESS_WRITERS 2
+#define STRESS_ITERS 200
+
+static struct rwlock rw;
+static struct semaphore done;
+
+/* Protected by disabling interrupts. */
+static int active_readers;
+static int max_readers;
+
+/* Protected by RW. */
+static int value_a, value_b;
+static int torn_reads;
+
+static thread_func sleeping_reader;
+static thread_func stress_reader;
+static thread_func stress_writer;
+
+void
+test_rwlock_readers (void) 
+{
+  int i;
+
+  rwlock_init (&rw);
+  sema_init (&done, 0);
+
+  msg ("Creating %d readers that sleep while holding the lock.",
+       READER_CNT);
+  for (i = 0; i < READER_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "reader %d", i);
+      thread_create (name, PRI_DEFAULT, sleeping_reader, NULL);
+    }
+  for (i = 0; i < READER_CNT; i++)
+    sema_down (&done);
+  msg ("%d readers held the lock at once.", max_readers);
+
+  msg ("Running %d readers and %d writers, %d iterations each.",
+       STRESS_READERS, STRESS_WRITERS, STRESS_ITERS);
+  for (i = 0; i < STRESS_READERS; i++) 
+    thread_create ("stress reader", PRI_DEFAULT, stress_reader, NULL);
+  for (i = 0; i < STRESS_WRITERS; i++) 
+    thread_create ("stress writer", PRI_DEFAULT, stress_writer, NULL);
+  for (i = 0; i < STRESS_READERS + STRESS_WRITERS; i++)
+    sema_down (&done);
+
+  if (torn_reads != 0)
+    fail ("readers saw %d inconsistent values", torn_reads);
+  if (value_a != STRESS_WRITERS * STRESS_ITERS)
+    fail ("writers made %d updates, expected %d",
+          value_a, STRESS_WRITERS * STRESS_ITERS);
+  msg ("Readers saw no inconsistent values.");
+}
+
+static void
+sleeping_reader (void *aux UNUSED) 
+{
+  enum intr_level old_level;
+
+  rwlock_acquire_read (&rw);
+
+  old_level = intr_disable ();
+  if (++active_readers > max_readers)
+    max_readers = active_readers;
+  intr_set_level (old_level);
+
+  timer_sleep (10);
+
+  old_level = intr_disable ();
+  active_readers--;
+  intr_set_level (old_level);
+
+  rwlock_release_read (&rw);
+  sema_up (&done);
+}
+
+static void
+stress_reader (void *aux UNUSED) 
+{
+  int i;
+
+  for (i = 0; i < STRESS_ITERS; i++) 
+    {
+      rwlock_acquire_read (&rw);
+      if (value_a != value_b)
+        torn_reads++;
+      thread_yield ();
+      if (value_a != value_b)
+        torn_reads++;
+      rwlock_release_read (&rw);
+      thread_yield ();
+    }
+  sema_up (&done);
+}
+
+static void
+stress_writer (void *aux UNUSED) 
+{
+  int i;
+
+  for (i = 0; i < STRESS_ITERS; i++) 
+    {
+      rwlock_acquire_write (&rw);
+      value_a++;
+      thread_yield ();
+      value_b++;
+      rwlock_release_write (&rw);
+      thread_yield ();
+    }
+  sema_up (&done);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-readers) begin
+(rwlock-readers) Creating 5 readers that sleep while holding the lock.
+(rwlock-readers) 5 readers held the lock at once.
+(rwlock-readers) Running 4 readers and 2 writers, 200 iterations each.
+(rwlock-readers) Readers saw no inconsistent values.
+(rwlock-readers) end
+EOF
+pass;
@@ -0,0 +1,61 @@
+/* Checks that a waiting writer is preferred over new readers.
+
+   The main thread holds a readers-writer lock for reading.  A
+   higher-priority writer then blocks trying to acquire it for
+   writing, and a higher-priority reader blocks behind the
+   waiting writer even though the lock is only held for reading.
+   When the main thread releases the lock, the writer must get
+   it first, then the reader. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func writer_thread;
+static thread_func reader_thread;
+
+void
+test_rwlock_writer (void) 
+{
+  struct rwlock rw;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rw);
+  rwlock_acquire_read (&rw);
+  msg ("Main thread acquired the lock for reading.");
+  thread_create ("writer", PRI_DEFAULT + 1, writer_thread, &rw);
+  msg ("Writer is waiting.");
+  thread_create ("reader", PRI_DEFAULT + 1, reader_thread, &rw);
+  msg ("Reader is waiting behind the writer.");
+  rwlock_release_read (&rw);
+  msg ("Main thread finished.");
+}
+
+static void
+writer_thread (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  rwlock_acquire_write (rw);
+  msg ("Writer acquired the lock.");
+  rwlock_release_write (rw);
+  msg ("Writer finished.");
+}
+
+static void
+reader_thread (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  rwlock_acquire_read (rw);
+  msg ("Reader acquired the lock.");
+  rwlock_release_read (rw);
+  msg ("Reader finished.");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-writer) begin
+(rwlock-writer) Main thread acquired the lock for reading.
+(rwlock-writer) Writer is waiting.
+(rwlock-writer) Reader is waiting behind the writer.
+(rwlock-writer) Writer acquired the lock.
+(rwlock-writer) Writer finished.
+(rwlock-writer) Reader acquired the lock.
+(rwlock-writer) Reader finished.
+(rwlock-writer) Main thread finished.
+(rwlock-writer) end
+EOF
+pass;
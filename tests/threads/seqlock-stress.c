@@ -0,0 +1,111 @@
+/* Checks that sequence-lock readers never see a torn update.
+
+   Writer threads repeatedly store the same counter value into
+   both halves of a pair under a sequence lock, while reader
+   threads read the pair without locking and retry whenever a
+   write intervened.  Readers also check that timer_ticks(),
+   which is read through a sequence lock, never goes backward. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define READER_CNT 4
+#define WRITER_CNT 2
+#define ITER_CNT 1000
+
+static struct seqlock sl;
+static struct semaphore done;
+
+/* Protected by SL. */
+static int64_t pair[2];
+
+/* Updated with interrupts off. */
+static int torn_reads;
+static int backward_ticks;
+
+static thread_func seqlock_reader;
+static thread_func seqlock_writer;
+
+void
+test_seqlock_stress (void) 
+{
+  int i;
+
+  seqlock_init (&sl);
+  sema_init (&done, 0);
+
+  msg ("Running %d readers and %d writers, %d iterations each.",
+       READER_CNT, WRITER_CNT, ITER_CNT);
+  for (i = 0; i < READER_CNT; i++) 
+    thread_create ("reader", PRI_DEFAULT, seqlock_reader, NULL);
+  for (i = 0; i < WRITER_CNT; i++) 
+    thread_create ("writer", PRI_DEFAULT, seqlock_writer, NULL);
+  for (i = 0; i < READER_CNT + WRITER_CNT; i++)
+    sema_down (&done);
+
+  if (torn_reads != 0)
+    fail ("readers saw %d torn values", torn_reads);
+  if (backward_ticks != 0)
+    fail ("timer_ticks() went backward %d times", backward_ticks);
+  if (pair[0] != WRITER_CNT * ITER_CNT)
+    fail ("writers made %lld updates, expected %d",
+          pair[0], WRITER_CNT * ITER_CNT);
+  msg ("Readers saw no torn values.");
+}
+
+static void
+seqlock_reader (void *aux UNUSED) 
+{
+  int64_t last_ticks = timer_ticks ();
+  int i;
+
+  for (i = 0; i < ITER_CNT; i++) 
+    {
+      int64_t a, b, now;
+      unsigned seq;
+
+      do
+        {
+          seq = seqlock_read_begin (&sl);
+          a = pair[0];
+          b = pair[1];
+        }
+      while (seqlock_read_retry (&sl, seq));
+
+      now = timer_ticks ();
+      if (a != b || now < last_ticks) 
+        {
+          enum intr_level old_level = intr_disable ();
+          if (a != b)
+            torn_reads++;
+          if (now < last_ticks)
+            backward_ticks++;
+          intr_set_level (old_level);
+        }
+      last_ticks = now;
+
+      if (i % 16 == 0)
+        thread_yield ();
+    }
+  sema_up (&done);
+}
+
+static void
+seqlock_writer (void *aux UNUSED) 
+{
+  int i;
+
+  for (i = 0; i < ITER_CNT; i++) 
+    {
+      enum intr_level old_level = seqlock_write_begin (&sl);
+      pair[0]++;
+      pair[1]++;
+      seqlock_write_end (&sl, old_level);
+      thread_yield ();
+    }
+  sema_up (&done);
+}
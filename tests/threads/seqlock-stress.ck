@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(seqlock-stress) begin
+(seqlock-stress) Running 4 readers and 2 writers, 1000 iterations each.
+(seqlock-stress) Readers saw no torn values.
+(seqlock-stress) end
+EOF
+pass;
@@ -32,6 +32,9 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_rwlock_readers;
+extern test_func test_rwlock_writer;
+extern test_func test_seqlock_stress;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
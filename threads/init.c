@@ -22,6 +22,10 @@
 #include "threads/palloc.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
+/*Added by moon*/
+#include "threads/vmalloc.h"
+/*Added by moon*/
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -37,6 +41,12 @@
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
+/*Added by moon*/
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/swap.h"
+#endif
+/*Added by moon*/
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
@@ -57,6 +67,11 @@ static const char *swap_bdev_name;
 /* -ul: Maximum number of pages to put into palloc's user pool. */
 static size_t user_page_limit = SIZE_MAX;
 
+/*Added by moon*/
+/* -trace: Record scheduler events and dump them at shutdown? */
+static bool trace_sched;
+/*Added by moon*/
+
 static void bss_init (void);
 static void paging_init (void);
 
@@ -98,6 +113,18 @@ main (void)
   palloc_init (user_page_limit);
   malloc_init ();
   paging_init ();
+  /*Added by moon*/
+  vmalloc_init ();
+  /*Added by moon*/
+  /*Added by moon*/
+#ifdef VM
+  frame_init ();
+#endif
+  /*Added by moon*/
+  /*Added by moon*/
+  if (trace_sched)
+    trace_init ();
+  /*Added by moon*/
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -126,6 +153,12 @@ main (void)
   locate_block_devices ();
   filesys_init (format_filesys);
 #endif
+  /*Added by moon*/
+#ifdef VM
+  swap_init ();
+  frame_reclaim_start ();
+#endif
+  /*Added by moon*/
 
   printf ("Boot complete.\n");
   
@@ -256,6 +289,10 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-tickless"))
+        timer_tickless = true;
+      else if (!strcmp (name, "-trace"))
+        trace_sched = true;
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -379,6 +416,8 @@ usage (void)
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -tickless          Stop the periodic timer tick while idle.\n"
+          "  -trace             Trace scheduler events, dump at shutdown.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -8,6 +8,9 @@
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+/*Added by moon*/
+#include "threads/vmalloc.h"
+/*Added by moon*/
 
 /* A simple implementation of malloc().
 
@@ -107,7 +110,13 @@ malloc (size_t size)
       /* SIZE is too big for any descriptor.
          Allocate enough pages to hold SIZE plus an arena. */
       size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
-      a = palloc_get_multiple (0, page_cnt);
+      /*Added by moon*/
+      /*多页的大块从vmalloc区域分配，不需要物理上连续的页。vmalloc还没有
+      初始化或者地址空间用完时再退回到palloc*/
+      a = page_cnt > 1 ? vmalloc (page_cnt, 0) : NULL;
+      if (a == NULL)
+        a = palloc_get_multiple (0, page_cnt);
+      /*Added by moon*/
       if (a == NULL)
         return NULL;
 
@@ -257,7 +266,12 @@ free (void *p)
       else
         {
           /* It's a big block.  Free its pages. */
-          palloc_free_multiple (a, a->free_cnt);
+          /*Added by moon*/
+          if (is_vmalloc_vaddr (a))
+            vfree (a);
+          else
+            palloc_free_multiple (a, a->free_cnt);
+          /*Added by moon*/
           return;
         }
     }
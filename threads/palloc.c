@@ -2,6 +2,7 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -9,6 +10,7 @@
 #include <string.h>
 #include "threads/loader.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -23,22 +25,76 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Within a pool, free pages are managed by a buddy allocator.
+   Free memory is kept as blocks of 2**ORDER pages, each aligned
+   to its own size relative to the pool base, on one free list
+   per order.  A request is served from the smallest sufficient
+   block, splitting larger blocks as needed, and a freed block is
+   merged with its buddy whenever the buddy is free too.  Both
+   take O(log n) time in the size of the pool.
+
+   Each pool also keeps a small reserve of single pages that are
+   already filled with zeros.  The idle thread refills both
+   pools' reserves by calling palloc_zero_idle() whenever the CPU
+   has nothing else to do, so that PAL_ZERO requests, such as
+   fresh user stack and BSS pages or new page tables, usually
+   need not zero a page synchronously.  Reserved pages still count as
+   free and are handed out for other requests when the pool is
+   otherwise exhausted. */
+
+/*Added by moon*/
+/*最大的块是2**(PAL_ORDER_CNT-1)页，即2GB，足够覆盖Pintos能用的全部物理内存*/
+#define PAL_ORDER_CNT 20
+
+/*free_order[]中空闲块的第一页的标记，低位是块的order，其他页为0*/
+#define FREE_HEAD 0x80
+
+/*每个pool最多预先清零的页数*/
+#define ZERO_RESERVE_MAX 64
+/*Added by moon*/
 
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
+    /*Added by moon*/
+    /*伙伴算法每次操作只需要O(log n)时间，用自旋锁保护，
+    这样在关中断的情况下（比如thread_schedule_tail()中）也可以释放页*/
+    struct spinlock lock;               /* Mutual exclusion. */
+    /*Added by moon*/
     struct bitmap *used_map;            /* Bitmap of free pages. */
     uint8_t *base;                      /* Base of pool. */
+    /*Added by moon*/
+    size_t page_cnt;                    /* Number of pages in pool. */
+    size_t free_cnt;                    /* Number of free pages. */
+    uint8_t *free_order;                /* Per page: FREE_HEAD | order
+                                           if a free block starts here. */
+    struct list free_list[PAL_ORDER_CNT]; /* Free blocks, by order. */
+    void *zeroed[ZERO_RESERVE_MAX];     /* Free pages already zeroed. */
+    size_t zeroed_cnt;                  /* Number of pages in ZEROED. */
+    size_t zeroed_max;                  /* Size of reserve to keep. */
+    /*Added by moon*/
   };
 
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
+/*Added by moon*/
+/*PAL_ZERO申请的页数，分别是从预先清零的页中取得的和当场清零的*/
+static long long zero_hits, zero_misses;
+/*Added by moon*/
+
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+/*Added by moon*/
+static size_t buddy_alloc (struct pool *, size_t page_cnt);
+static void buddy_free (struct pool *, size_t page_idx, size_t page_cnt);
+static void buddy_free_block (struct pool *, size_t page_idx, int order);
+static struct list_elem *block_elem (const struct pool *, size_t page_idx);
+static bool refill_zeroed (struct pool *);
+/*Added by moon*/
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -73,18 +129,45 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
   void *pages;
   size_t page_idx;
+  /*Added by moon*/
+  enum intr_level old_level;
+  /*Added by moon*/
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
-
+  /*Added by moon*/
+  old_level = spin_lock (&pool->lock);
+  if (page_cnt == 1 && (flags & PAL_ZERO) && pool->zeroed_cnt > 0)
+    {
+      /*预先清零的页已经从伙伴分配器中取出，只是还算作空闲的*/
+      pages = pool->zeroed[--pool->zeroed_cnt];
+      pool->free_cnt--;
+      zero_hits++;
+      spin_unlock (&pool->lock, old_level);
+      return pages;
+    }
+  page_idx = buddy_alloc (pool, page_cnt);
   if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
+    {
+      ASSERT (!bitmap_any (pool->used_map, page_idx, page_cnt));
+      bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+      pool->free_cnt -= page_cnt;
+      pages = pool->base + PGSIZE * page_idx;
+    }
+  else if (page_cnt == 1 && pool->zeroed_cnt > 0)
+    {
+      /*伙伴分配器中已经没有空闲页了，动用预先清零的页*/
+      pages = pool->zeroed[--pool->zeroed_cnt];
+      pool->free_cnt--;
+      flags &= ~PAL_ZERO;
+    }
   else
     pages = NULL;
+  if (pages != NULL && (flags & PAL_ZERO))
+    zero_misses += page_cnt;
+  spin_unlock (&pool->lock, old_level);
+  /*Added by moon*/
 
   if (pages != NULL) 
     {
@@ -119,6 +202,9 @@ palloc_free_multiple (void *pages, size_t page_cnt)
 {
   struct pool *pool;
   size_t page_idx;
+  /*Added by moon*/
+  enum intr_level old_level;
+  /*Added by moon*/
 
   ASSERT (pg_ofs (pages) == 0);
   if (pages == NULL || page_cnt == 0)
@@ -137,8 +223,14 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
+  /*Added by moon*/
+  old_level = spin_lock (&pool->lock);
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  buddy_free (pool, page_idx, page_cnt);
+  pool->free_cnt += page_cnt;
+  spin_unlock (&pool->lock, old_level);
+  /*Added by moon*/
 }
 
 /* Frees the page at PAGE. */
@@ -148,6 +240,37 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/*Added by moon*/
+/* Returns the number of free pages in the user pool if PAL_USER
+   is set in FLAGS, otherwise in the kernel pool.  The count may
+   be stale by the time the caller looks at it. */
+size_t
+palloc_free_count (enum palloc_flags flags)
+{
+  const struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  return pool->free_cnt;
+}
+
+/* Refills the user pool's and then the kernel pool's reserve of
+   zeroed pages.  Called by the idle thread with interrupts on.
+   Pages are zeroed one at a time without holding the pool lock,
+   and the refill stops between pages as soon as a thread is
+   ready to run. */
+void
+palloc_zero_idle (void)
+{
+  if (refill_zeroed (&user_pool))
+    refill_zeroed (&kernel_pool);
+}
+/* Prints statistics about zeroed page allocation. */
+void
+palloc_print_stats (void)
+{
+  printf ("Zeroed pages: %lld from reserve, %lld zeroed on demand\n",
+          zero_hits, zero_misses);
+}
+/*Added by moon*/
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
@@ -156,7 +279,12 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
   /* We'll put the pool's used_map at its base.
      Calculate the space needed for the bitmap
      and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  /*Added by moon*/
+  /*free_order[]紧跟在bitmap后面，每页占一个字节*/
+  size_t bm_bytes = ROUND_UP (bitmap_buf_size (page_cnt), sizeof (long));
+  size_t bm_pages = DIV_ROUND_UP (bm_bytes + page_cnt, PGSIZE);
+  int order;
+  /*Added by moon*/
   if (bm_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
@@ -164,9 +292,23 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
   /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
+  /*Added by moon*/
+  spin_init (&p->lock);
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_bytes);
   p->base = base + bm_pages * PGSIZE;
+  p->page_cnt = page_cnt;
+  p->free_cnt = page_cnt;
+  p->free_order = (uint8_t *) base + bm_bytes;
+  memset (p->free_order, 0, page_cnt);
+  for (order = 0; order < PAL_ORDER_CNT; order++)
+    list_init (&p->free_list[order]);
+  p->zeroed_cnt = 0;
+  p->zeroed_max = page_cnt / 16 < ZERO_RESERVE_MAX ? page_cnt / 16
+                                                    : ZERO_RESERVE_MAX;
+
+  /*一开始所有的页都是空闲的*/
+  buddy_free (p, 0, page_cnt);
+  /*Added by moon*/
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -180,3 +322,144 @@ page_from_pool (const struct pool *pool, void *page)
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/*Added by moon*/
+/*返回POOL中从第PAGE_IDX页开始的空闲块的链表元素，它存放在块的第一页中*/
+static struct list_elem *
+block_elem (const struct pool *pool, size_t page_idx)
+{
+  return (struct list_elem *) (pool->base + PGSIZE * page_idx);
+}
+
+/*一页一页地清零，补充POOL的预留，直到预留满了、没有空闲页了或者有线程
+就绪。因为有线程就绪而停下时返回false*/
+static bool
+refill_zeroed (struct pool *pool)
+{
+  enum intr_level old_level;
+
+  for (;;)
+    {
+      size_t page_idx;
+      void *page;
+
+      if (thread_ready_waiting ())
+        return false;
+
+      old_level = spin_lock (&pool->lock);
+      if (pool->zeroed_cnt >= pool->zeroed_max)
+        page_idx = BITMAP_ERROR;
+      else
+        page_idx = buddy_alloc (pool, 1);
+      if (page_idx != BITMAP_ERROR)
+        bitmap_mark (pool->used_map, page_idx);
+      spin_unlock (&pool->lock, old_level);
+      if (page_idx == BITMAP_ERROR)
+        return true;
+
+      page = pool->base + PGSIZE * page_idx;
+      memset (page, 0, PGSIZE);
+
+      /*清零期间别的线程可能已经填满了预留，这一页就还给伙伴分配器*/
+      old_level = spin_lock (&pool->lock);
+      if (pool->zeroed_cnt < pool->zeroed_max)
+        pool->zeroed[pool->zeroed_cnt++] = page;
+      else
+        {
+          bitmap_reset (pool->used_map, page_idx);
+          buddy_free (pool, page_idx, 1);
+        }
+      spin_unlock (&pool->lock, old_level);
+    }
+}
+
+/*从POOL中分配PAGE_CNT个连续的页，返回第一页的序号，没有足够大的空闲块时
+返回BITMAP_ERROR。必须持有POOL的锁*/
+static size_t
+buddy_alloc (struct pool *pool, size_t page_cnt)
+{
+  int order, want;
+  size_t page_idx;
+
+  /*能容纳PAGE_CNT页的最小的order*/
+  for (want = 0; want < PAL_ORDER_CNT && ((size_t) 1 << want) < page_cnt;
+       want++)
+    continue;
+
+  /*找到不小于want的最小的非空链表*/
+  for (order = want; order < PAL_ORDER_CNT; order++)
+    if (!list_empty (&pool->free_list[order]))
+      break;
+  if (order >= PAL_ORDER_CNT)
+    return BITMAP_ERROR;
+
+  page_idx = pg_no (list_pop_front (&pool->free_list[order]))
+             - pg_no (pool->base);
+  ASSERT (pool->free_order[page_idx] == (FREE_HEAD | order));
+  pool->free_order[page_idx] = 0;
+
+  /*把大块逐次对半分开，后一半放回低一级的链表*/
+  while (order > want)
+    {
+      size_t buddy;
+
+      order--;
+      buddy = page_idx + ((size_t) 1 << order);
+      pool->free_order[buddy] = FREE_HEAD | order;
+      list_push_front (&pool->free_list[order], block_elem (pool, buddy));
+    }
+
+  /*PAGE_CNT不是2的幂时，多出来的页马上还回去*/
+  if (page_cnt < ((size_t) 1 << want))
+    buddy_free (pool, page_idx + page_cnt, ((size_t) 1 << want) - page_cnt);
+  return page_idx;
+}
+
+/*把POOL中从第PAGE_IDX页开始的PAGE_CNT页还给伙伴分配器。这段页被拆成
+若干个按自身大小对齐的块，分别释放。必须持有POOL的锁*/
+static void
+buddy_free (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  while (page_cnt > 0)
+    {
+      int order = 0;
+
+      /*在对齐和剩余长度允许的范围内取尽可能大的块*/
+      while (order + 1 < PAL_ORDER_CNT
+             && (page_idx & ((size_t) 1 << order)) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+
+      buddy_free_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/*释放POOL中从第PAGE_IDX页开始、大小为2**ORDER页的块，
+只要伙伴块也是空闲的就和它合并。必须持有POOL的锁*/
+static void
+buddy_free_block (struct pool *pool, size_t page_idx, int order)
+{
+  ASSERT (page_idx % ((size_t) 1 << order) == 0);
+
+  while (order + 1 < PAL_ORDER_CNT)
+    {
+      size_t buddy = page_idx ^ ((size_t) 1 << order);
+
+      if (buddy + ((size_t) 1 << order) > pool->page_cnt
+          || pool->free_order[buddy] != (FREE_HEAD | order))
+        break;
+
+      /*伙伴也是空闲的，把它从链表中取下，合并成更大的块*/
+      list_remove (block_elem (pool, buddy));
+      pool->free_order[buddy] = 0;
+      if (buddy < page_idx)
+        page_idx = buddy;
+      order++;
+    }
+
+  pool->free_order[page_idx] = FREE_HEAD | order;
+  list_push_front (&pool->free_list[order], block_elem (pool, page_idx));
+}
+/*Added by moon*/
@@ -16,5 +16,10 @@ void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+/*Added by moon*/
+size_t palloc_free_count (enum palloc_flags);
+void palloc_zero_idle (void);
+void palloc_print_stats (void);
+/*Added by moon*/
 
 #endif /* threads/palloc.h */
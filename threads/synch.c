@@ -31,6 +31,15 @@
 #include <string.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+/*Added by moon*/
+#include "threads/trace.h"
+
+/*进入等待队列的序号，优先级相同的等待者按照序号先来先唤醒*/
+static unsigned wait_seq;
+
+static bool waiter_higher (const struct heap_elem *, const struct heap_elem *,
+                           void *aux);
+/*Added by moon*/
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -47,7 +56,9 @@ sema_init (struct semaphore *sema, unsigned value)
   ASSERT (sema != NULL);
 
   sema->value = value;
-  list_init (&sema->waiters);
+  /*Added by moon*/
+  heap_init (&sema->waiters, waiter_higher, NULL);
+  /*Added by moon*/
   /*Added by moon*/
   sema->sema_priority = PRI_MIN-1;
   /*Added by moon*/
@@ -69,9 +80,19 @@ sema_down (struct semaphore *sema)
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
+  /*Added by moon*/
+  TRACE (TRACE_SEMA_DOWN, thread_current ()->tid, sema);
+  /*Added by moon*/
   while (sema->value == 0) 
     {
-      list_push_back (&sema->waiters, &thread_current ()->elem);
+      /*Added by moon*/
+      /*按照优先级放入等待者的堆中，并记下在等哪个信号量，被捐赠优先级时
+      要在这个堆中调整位置*/
+      struct thread *curr = thread_current ();
+      curr->wait_seq = wait_seq++;
+      curr->sema_waiting = sema;
+      heap_insert (&sema->waiters, &curr->waitelem);
+      /*Added by moon*/
       thread_block ();
     }
   sema->value--;
@@ -120,23 +141,33 @@ sema_up (struct semaphore *sema)
   /*Added by moon*/
 
   old_level = intr_disable ();
-  if (!list_empty (&sema->waiters)) 
+  /*Added by moon*/
+  TRACE (TRACE_SEMA_UP, thread_current ()->tid, sema);
+  /*Added by moon*/
+  if (!heap_empty (&sema->waiters)) 
   {
      /*thread_unblock (list_entry (list_pop_front (&sema->waiters),
                                 struct thread, elem));*/
      /*Added by moon*/
-     /*对sema的waiters队列按照优先级进行排序*/
-     list_sort (&sema->waiters, priority_higher, NULL); 
-     /*唤醒队列头，也就是队列中优先级最高的线程*/
-     wake_up = list_entry (list_pop_front (&sema->waiters), struct thread, elem);
+     /*唤醒堆顶，也就是等待者中优先级最高的线程。mlfqs下等待者的优先级
+     是它开始等待时的优先级，被唤醒时才会补算*/
+     wake_up = heap_entry (heap_pop_front (&sema->waiters), struct thread,
+                           waitelem);
+     wake_up->sema_waiting = NULL;
      thread_unblock (wake_up);
      /*Added by moon*/
   }
   sema->value++;
   /*Added by moon*/
-  /*如果当前线程的优先级比唤醒的线程的低，就要放弃CPU*/
+  /*如果当前线程的优先级比唤醒的线程的低，就要放弃CPU。在中断处理程序中
+  不能直接让出CPU，要等中断返回时再让出*/
   if(wake_up != NULL && thread_current()->priority < wake_up->priority)
-     thread_yield();
+  {
+     if (intr_context ())
+       intr_yield_on_return ();
+     else
+       thread_yield();
+  }
   /*Added by moon*/
   intr_set_level (old_level);
 }
@@ -230,6 +261,7 @@ lock_acquire (struct lock *lock)
 
   /*初始化声明的变量*/
   curr = thread_current();
+  TRACE (TRACE_LOCK_ACQUIRE, curr->tid, lock);
   thrd = lock->holder;
   curr->blocked = another = lock;
 
@@ -240,7 +272,14 @@ lock_acquire (struct lock *lock)
     thrd->donated = true;
     thread_set_other_priority (thrd, curr->priority, false);
     if(another->lock_priority < curr->priority)
+    {
+      /*锁的优先级变了，要在持有者的locks堆中调整它的位置*/
+      if(!thread_mlfqs)
+        heap_remove (&thrd->locks, &another->holder_elem);
       another->lock_priority = curr->priority;
+      if(!thread_mlfqs)
+        heap_insert (&thrd->locks, &another->holder_elem);
+    }
 
     /*假如捐赠优先级的线程也因为缺锁被block,将another更新为它需要的锁，thrd更新为使它block的线程*/
     if(!thread_mlfqs && thrd->status == THREAD_BLOCKED && thrd->blocked != NULL)
@@ -262,9 +301,8 @@ lock_acquire (struct lock *lock)
     /*当前线程已经获得锁*/
     lock->lock_priority = curr->priority;
     curr->blocked = NULL;
-    /*将锁按照优先级的顺序插入当前线程的锁队列中*/
-    list_insert_ordered(&(curr->locks), &(lock->holder_elem), 
-                         lock_priority_higher, NULL);
+    /*将锁按照优先级放入当前线程的locks堆中*/
+    heap_insert (&curr->locks, &lock->holder_elem);
   }
   intr_set_level(old_level);
   /*Added by moon*/
@@ -286,7 +324,19 @@ lock_try_acquire (struct lock *lock)
 
   success = sema_try_down (&lock->semaphore);
   if (success)
+  {
     lock->holder = thread_current ();
+    /*Added by moon*/
+    /*和lock_acquire一样记录到当前线程的locks堆中，lock_release要把它取出来*/
+    if (!thread_mlfqs)
+    {
+      enum intr_level old_level = intr_disable ();
+      lock->lock_priority = lock->holder->priority;
+      heap_insert (&lock->holder->locks, &lock->holder_elem);
+      intr_set_level (old_level);
+    }
+    /*Added by moon*/
+  }
   return success;
 }
 
@@ -303,7 +353,6 @@ lock_release (struct lock *lock)
 
   /*Added by moon*/
   struct thread *curr;
-  struct list_elem *I;
   struct lock *another;
   enum intr_level old_level;
 
@@ -315,25 +364,25 @@ lock_release (struct lock *lock)
   lock->holder = NULL;
   if(!thread_mlfqs)
   {
-    /*将锁从相应的队列中移除*/
-    list_remove(&(lock->holder_elem));
+    /*将锁从当前线程的locks堆中移除*/
+    heap_remove (&curr->locks, &lock->holder_elem);
     lock->lock_priority = PRI_MIN-1;
   }
   sema_up (&lock->semaphore);
   /*Added by moon*/ 
   if(!thread_mlfqs)
   {
-    /*如果当前的线程持有的锁的队列为空，就恢复到原来的优先级*/
-    if(list_empty(&curr->locks))
+    /*如果当前的线程持有的锁的堆为空，就恢复到原来的优先级*/
+    if(heap_empty(&curr->locks))
     {
       curr->donated = false;
       thread_set_priority (curr->old_priority);
     }
-    /*否则将锁队列头的优先级捐赠给它，可以解决donate-multiple的问题*/
+    /*否则将堆顶的锁的优先级捐赠给它，可以解决donate-multiple的问题*/
     else
     {
-      I = list_front(&curr->locks);
-      another = list_entry(I, struct lock, holder_elem);
+      another = heap_entry (heap_front (&curr->locks), struct lock,
+                            holder_elem);
       thread_set_other_priority (thread_current(), another->lock_priority, false);
     }
   }
@@ -355,8 +404,9 @@ lock_held_by_current_thread (const struct lock *lock)
 /* One semaphore in a list. */
 struct semaphore_elem 
   {
-    struct list_elem elem;              /* List element. */
+    struct heap_elem elem;              /* Heap element. */
     struct semaphore semaphore;         /* This semaphore. */
+    unsigned seq;                       /* Order of arrival. */
   };
 
 /* Initializes condition variable COND.  A condition variable
@@ -367,7 +417,9 @@ cond_init (struct condition *cond)
 {
   ASSERT (cond != NULL);
 
-  list_init (&cond->waiters);
+  /*Added by moon*/
+  heap_init (&cond->waiters, sema_priority_higher, NULL);
+  /*Added by moon*/
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -404,8 +456,11 @@ cond_wait (struct condition *cond, struct lock *lock)
   /*Added by moon*/
   /*将waiter对应的semaphore的优先级设置为当前的优先级*/
   (waiter.semaphore).sema_priority = thread_current()->priority; 
-  /*将waiter按照优先级高优先的顺序插入cond的waiters队列*/
-  list_insert_ordered(&cond->waiters,&(waiter.elem),sema_priority_higher,NULL);
+  /*将waiter按照优先级放入cond的waiters堆中*/
+  enum intr_level old_level = intr_disable ();
+  waiter.seq = wait_seq++;
+  heap_insert (&cond->waiters, &waiter.elem);
+  intr_set_level (old_level);
   /*Added by moon*/
 
   /*list_push_back (&cond->waiters, &waiter.elem);*/
@@ -429,9 +484,11 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED)
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
 
-  if (!list_empty (&cond->waiters)) 
-    sema_up (&list_entry (list_pop_front (&cond->waiters),
+  /*Added by moon*/
+  if (!heap_empty (&cond->waiters)) 
+    sema_up (&heap_entry (heap_pop_front (&cond->waiters),
                           struct semaphore_elem, elem)->semaphore);
+  /*Added by moon*/
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -446,31 +503,253 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
 
-  while (!list_empty (&cond->waiters))
+  while (!heap_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
 
 /*Added by moon*/
-/*比较两个list_elem对应的锁的优先级*/
+/* Initializes spin lock LOCK as unheld. */
+void
+spin_init (struct spinlock *lock)
+{
+  ASSERT (lock != NULL);
+
+  lock->locked = 0;
+}
+
+/* Disables interrupts and busy-waits until LOCK can be taken.
+   Returns the previous interrupt level, which must be passed to
+   spin_unlock().  Spin locks are not recursive. */
+enum intr_level
+spin_lock (struct spinlock *lock)
+{
+  enum intr_level old_level;
+  int held;
+
+  ASSERT (lock != NULL);
+
+  old_level = intr_disable ();
+  for (;;)
+    {
+      /*xchg带有隐含的lock前缀，可以原子地读出旧值并写入1*/
+      held = 1;
+      asm volatile ("xchgl %0, %1" : "+r" (held), "+m" (lock->locked)
+                    : : "memory");
+      if (held == 0)
+        break;
+      while (lock->locked)
+        asm volatile ("pause");
+    }
+  return old_level;
+}
+
+/* Releases LOCK and restores the interrupt level OLD_LEVEL
+   returned by the matching spin_lock(). */
+void
+spin_unlock (struct spinlock *lock, enum intr_level old_level)
+{
+  ASSERT (lock != NULL);
+  ASSERT (lock->locked);
+
+  barrier ();
+  lock->locked = 0;
+  intr_set_level (old_level);
+}
+
+/* Initializes RW as an unheld readers-writer lock. */
+void
+rwlock_init (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_init (&rw->lock);
+  cond_init (&rw->can_read);
+  cond_init (&rw->can_write);
+  rw->readers = 0;
+  rw->waiting_writers = 0;
+  rw->writer = NULL;
+}
+
+/* Acquires RW for reading, sleeping until no writer holds it
+   or is waiting for it.  Must not be called by the thread that
+   holds RW for writing, and must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rwlock_held_for_write (rw));
+
+  lock_acquire (&rw->lock);
+  /*有写者在等待时新的读者也要等，否则写者可能永远等不到读者全部离开*/
+  while (rw->writer != NULL || rw->waiting_writers > 0)
+    cond_wait (&rw->can_read, &rw->lock);
+  rw->readers++;
+  lock_release (&rw->lock);
+}
+
+/* Releases RW, which the current thread holds for reading. */
+void
+rwlock_release_read (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_acquire (&rw->lock);
+  ASSERT (rw->readers > 0);
+  /*最后一个读者离开时让优先级最高的写者进入*/
+  if (--rw->readers == 0 && rw->waiting_writers > 0)
+    cond_signal (&rw->can_write, &rw->lock);
+  lock_release (&rw->lock);
+}
+
+/* Acquires RW for writing, sleeping until no other thread holds
+   it.  Must not be called within an interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rwlock_held_for_write (rw));
+
+  lock_acquire (&rw->lock);
+  rw->waiting_writers++;
+  while (rw->writer != NULL || rw->readers > 0)
+    cond_wait (&rw->can_write, &rw->lock);
+  rw->waiting_writers--;
+  rw->writer = thread_current ();
+  lock_release (&rw->lock);
+}
+
+/* Releases RW, which the current thread holds for writing. */
+void
+rwlock_release_write (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+  ASSERT (rwlock_held_for_write (rw));
+
+  lock_acquire (&rw->lock);
+  rw->writer = NULL;
+  /*还有写者在等就交给写者，否则唤醒所有等待的读者。
+  条件变量的等待者是按优先级排好的，唤醒的顺序也是优先级从高到低*/
+  if (rw->waiting_writers > 0)
+    cond_signal (&rw->can_write, &rw->lock);
+  else
+    cond_broadcast (&rw->can_read, &rw->lock);
+  lock_release (&rw->lock);
+}
+
+/* Returns true if the current thread holds RW for writing. */
 bool
-lock_priority_higher (const struct list_elem *a, const struct list_elem *b, void *aux UNUSED)
+rwlock_held_for_write (const struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  return rw->writer == thread_current ();
+}
+
+/* Initializes SL as a sequence lock with no write in
+   progress. */
+void
+seqlock_init (struct seqlock *sl)
+{
+  ASSERT (sl != NULL);
+
+  spin_init (&sl->lock);
+  sl->seq = 0;
+}
+
+/* Begins a read of the data protected by SL and returns the
+   sequence number to pass to seqlock_read_retry().  The read
+   is consistent only if seqlock_read_retry() then returns
+   false; otherwise it must be repeated.  For example:
+
+      do
+        {
+          seq = seqlock_read_begin (&sl);
+          value = protected_value;
+        }
+      while (seqlock_read_retry (&sl, seq)); */
+unsigned
+seqlock_read_begin (const struct seqlock *sl)
+{
+  unsigned seq;
+
+  /*序号为奇数时写者正在修改，等它写完*/
+  while ((seq = sl->seq) & 1)
+    asm volatile ("pause");
+  barrier ();
+  return seq;
+}
+
+/* Returns true if a write to SL happened since the
+   seqlock_read_begin() call that returned START. */
+bool
+seqlock_read_retry (const struct seqlock *sl, unsigned start)
+{
+  barrier ();
+  return sl->seq != start;
+}
+
+/* Begins a write of the data protected by SL.  Disables
+   interrupts and returns the previous interrupt level, which
+   must be passed to seqlock_write_end(). */
+enum intr_level
+seqlock_write_begin (struct seqlock *sl)
+{
+  enum intr_level old_level = spin_lock (&sl->lock);
+  sl->seq++;
+  barrier ();
+  return old_level;
+}
+
+/* Ends a write to SL and restores the interrupt level
+   OLD_LEVEL. */
+void
+seqlock_write_end (struct seqlock *sl, enum intr_level old_level)
+{
+  ASSERT (sl->seq & 1);
+
+  barrier ();
+  sl->seq++;
+  spin_unlock (&sl->lock, old_level);
+}
+
+/*比较两个heap_elem对应的锁的优先级*/
+bool
+lock_priority_higher (const struct heap_elem *a, const struct heap_elem *b, void *aux UNUSED)
 {
   struct lock *l1, *l2;
-  l1 = list_entry (a, struct lock, holder_elem);
-  l2 = list_entry (b, struct lock, holder_elem);
+  l1 = heap_entry (a, struct lock, holder_elem);
+  l2 = heap_entry (b, struct lock, holder_elem);
   return (l1->lock_priority > l2->lock_priority);
 }
 
-/*比较两个list_elem对应的semaphore_elem所对应的semaphore的优先级*/
+/*比较两个heap_elem对应的semaphore_elem所对应的semaphore的优先级，
+优先级相同时先等待的排在前面*/
 bool
-sema_priority_higher (const struct list_elem *a, const struct list_elem *b, void *aux UNUSED)
+sema_priority_higher (const struct heap_elem *a, const struct heap_elem *b, void *aux UNUSED)
 {
   struct semaphore_elem *elem1,*elem2;
   struct semaphore *s1, *s2;
-  elem1 = list_entry (a, struct semaphore_elem, elem);
-  elem2 = list_entry (b, struct semaphore_elem, elem);
+  elem1 = heap_entry (a, struct semaphore_elem, elem);
+  elem2 = heap_entry (b, struct semaphore_elem, elem);
   s1 = &(elem1->semaphore);
   s2 = &(elem2->semaphore);
-  return (s1->sema_priority > s2->sema_priority);
+  if (s1->sema_priority != s2->sema_priority)
+    return (s1->sema_priority > s2->sema_priority);
+  return (int) (elem1->seq - elem2->seq) < 0;
+}
+
+/*比较两个heap_elem对应的等待线程的优先级，优先级相同时先等待的排在前面*/
+static bool
+waiter_higher (const struct heap_elem *a, const struct heap_elem *b, void *aux UNUSED)
+{
+  struct thread *t1, *t2;
+  t1 = heap_entry (a, struct thread, waitelem);
+  t2 = heap_entry (b, struct thread, waitelem);
+  if (t1->priority != t2->priority)
+    return (t1->priority > t2->priority);
+  return (int) (t1->wait_seq - t2->wait_seq) < 0;
 }
 /*Added by moon*/
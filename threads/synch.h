@@ -1,14 +1,16 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <heap.h>
 #include <list.h>
 #include <stdbool.h>
+#include "threads/interrupt.h"
 
 /* A counting semaphore. */
 struct semaphore 
   {
     unsigned value;             /* Current value. */
-    struct list waiters;        /* List of waiting threads. */
+    struct heap waiters;        /* Waiting threads, by priority. */
     struct list_elem holder_elem;
     int sema_priority;
   };
@@ -25,7 +27,7 @@ struct lock
     struct thread *holder;      /* Thread holding lock (for debugging). */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
     /*Added by moon*/
-    struct list_elem holder_elem;/*用于加入到某个获得当前信号量的线程的locks队列中*/
+    struct heap_elem holder_elem;/*用于加入到某个获得当前信号量的线程的locks堆中*/
     int lock_priority;           /*当前获得锁的线程的优先级*/
     /*Added by moon*/
   };
@@ -39,7 +41,7 @@ bool lock_held_by_current_thread (const struct lock *);
 /* Condition variable. */
 struct condition 
   {
-    struct list waiters;        /* List of waiting threads. */
+    struct heap waiters;        /* Waiting threads, by priority. */
   };
 
 void cond_init (struct condition *);
@@ -47,6 +49,57 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/*Added by moon*/
+/* Spin lock.  Busy-waits instead of sleeping, so it may be used
+   in the scheduler and in interrupt handlers.  Interrupts stay
+   disabled while it is held. */
+struct spinlock
+  {
+    volatile int locked;        /* 1 while held, 0 otherwise. */
+  };
+
+void spin_init (struct spinlock *);
+enum intr_level spin_lock (struct spinlock *);
+void spin_unlock (struct spinlock *, enum intr_level);
+
+/* Readers-writer lock.  Any number of readers may hold it at
+   once, or a single writer.  Writers are preferred: once a
+   writer is waiting, new readers wait behind it.  Waiters are
+   woken in priority order. */
+struct rwlock
+  {
+    struct lock lock;           /* Protects the members below. */
+    struct condition can_read;  /* Signaled when readers may enter. */
+    struct condition can_write; /* Signaled when a writer may enter. */
+    unsigned readers;           /* # of threads holding it for reading. */
+    unsigned waiting_writers;   /* # of threads waiting to write. */
+    struct thread *writer;      /* Thread holding it for writing. */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_held_for_write (const struct rwlock *);
+
+/* Sequence lock.  Protects small values that are read far more
+   often than written.  Readers never block or disable
+   interrupts; they retry if a write happened meanwhile.
+   Writers exclude each other with a spin lock. */
+struct seqlock
+  {
+    struct spinlock lock;       /* Serializes writers. */
+    volatile unsigned seq;      /* Odd while a write is in progress. */
+  };
+
+void seqlock_init (struct seqlock *);
+unsigned seqlock_read_begin (const struct seqlock *);
+bool seqlock_read_retry (const struct seqlock *, unsigned start);
+enum intr_level seqlock_write_begin (struct seqlock *);
+void seqlock_write_end (struct seqlock *, enum intr_level);
+/*Added by moon*/
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
@@ -55,11 +108,11 @@ void cond_broadcast (struct condition *, struct lock *);
 #define barrier() asm volatile ("" : : : "memory")
 
 /*Added by moon*/
-/*比较两个list_elem对应的锁的优先级*/
-bool lock_priority_higher (const struct list_elem *, const struct list_elem *, void *aux);
+/*比较两个heap_elem对应的锁的优先级*/
+bool lock_priority_higher (const struct heap_elem *, const struct heap_elem *, void *aux);
 
-/*比较两个list_elem对应的semaphore_elem所对应的semaphore的优先级*/
-bool sema_priority_higher (const struct list_elem *, const struct list_elem *, void *aux);
+/*比较两个heap_elem对应的semaphore_elem所对应的semaphore的优先级*/
+bool sema_priority_higher (const struct heap_elem *, const struct heap_elem *, void *aux);
 /*Added by moon*/
 
 #endif /* threads/synch.h */
@@ -13,6 +13,8 @@
 #include "threads/vaddr.h"
 /*Added by moon*/
 #include "threads/fixed-point.h"
+#include "threads/trace.h"
+#include "devices/timer.h"
 /*Added by moon*/
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -23,14 +25,32 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/*Added by moon*/
+/* Run queue of processes in THREAD_READY state, that is,
+   processes that are ready to run but not actually running.
+   There is one FIFO list per priority level, and bit P of
+   ready_mask is set exactly when ready_queue[P] is nonempty. */
+#define PRI_CNT (PRI_MAX - PRI_MIN + 1)
+#if PRI_CNT > 64
+#error ready_mask holds at most 64 priority levels
+#endif
+static struct list ready_queue[PRI_CNT];
+static uint64_t ready_mask;
+static size_t ready_cnt;        /* # of threads in ready_queue. */
+/*Added by moon*/
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
 static struct list all_list;
 
+/*Added by moon*/
+/*按tid索引的线程表。tid是顺序分配的，所以直接用tid的低位选桶，
+每个桶里只有很少几个线程。和all_list一样，线程在创建时加入、
+在thread_exit()时移除，由关中断保护*/
+#define TID_BUCKET_CNT 256
+static struct list tid_table[TID_BUCKET_CNT];
+/*Added by moon*/
+
 /* Idle thread. */
 static struct thread *idle_thread;
 
@@ -40,6 +60,15 @@ static struct thread *initial_thread;
 /* Lock used by allocate_tid(). */
 static struct lock tid_lock;
 
+/*Added by moon*/
+/*已退出线程的页的缓存。thread_create优先从这里取页，不用每次都经过palloc
+的pool锁和bitmap扫描；缓存满了才把页还给palloc*/
+#define THREAD_CACHE_MAX 16
+static struct thread *thread_cache[THREAD_CACHE_MAX];
+static size_t thread_cache_cnt;
+static struct spinlock thread_cache_lock;
+/*Added by moon*/
+
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame 
   {
@@ -64,6 +93,12 @@ bool thread_mlfqs;
 
 /*Added by moon*/
 int64_t load_avg;
+
+/*最近DECAY_HISTORY秒中每一秒recent_cpu的衰减系数2*load_avg/(2*load_avg+1)，
+第s秒的系数存放在decay_history[s % DECAY_HISTORY]中*/
+#define DECAY_HISTORY 64
+static int64_t decay_history[DECAY_HISTORY];
+static int decay_seconds;       /*系统已经进行过的recent_cpu衰减次数*/
 /*Added by moon*/
 
 static void kernel_thread (thread_func *, void *aux);
@@ -77,6 +112,18 @@ static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+/*Added by moon*/
+static void ready_push (struct thread *);
+static void ready_remove (struct thread *);
+static int ready_max_priority (void);
+static void catch_up_recent_cpu (struct thread *);
+static struct list *tid_bucket (tid_t);
+static void tid_table_insert (struct thread *);
+static struct thread *thread_page_get (void);
+static void thread_page_put (struct thread *);
+static void renew_ready_threads (void);
+static int64_t pow_fp (int64_t, int);
+/*Added by moon*/
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -96,8 +143,21 @@ thread_init (void)
 {
   ASSERT (intr_get_level () == INTR_OFF);
 
+  /*Added by moon*/
+  int pri, i;
+  /*Added by moon*/
+
   lock_init (&tid_lock);
-  list_init (&ready_list);
+  /*Added by moon*/
+  for (pri = PRI_MIN; pri <= PRI_MAX; pri++)
+    list_init (&ready_queue[pri - PRI_MIN]);
+  ready_mask = 0;
+  ready_cnt = 0;
+  spin_init (&thread_cache_lock);
+  thread_cache_cnt = 0;
+  for (i = 0; i < TID_BUCKET_CNT; i++)
+    list_init (&tid_table[i]);
+  /*Added by moon*/
   list_init (&all_list);
 
   /* Set up a thread structure for the running thread. */
@@ -106,6 +166,9 @@ thread_init (void)
   initial_thread->status = THREAD_RUNNING;
   initial_thread->tid = allocate_tid ();
   /*Added by moon*/
+  tid_table_insert (initial_thread);
+  /*Added by moon*/
+  /*Added by moon*/
   load_avg = 0;
   /*Added by moon*/
 }
@@ -154,15 +217,22 @@ thread_tick (void)
     /*每个timer_tick更新一次当前线程的recent_cpu(当前线程不为idle_thread时)*/
     if(t != idle_thread)
       t->recent_cpu = add_int(t->recent_cpu,1);
-    /*每100个timer_ticks更新一次系统的load_avg和所有线程的recent_cpu*/
+    /*每100个timer_ticks更新一次系统的load_avg，并记下这一秒的衰减系数。
+    只有正在运行的线程和ready队列中的线程立即衰减recent_cpu，被阻塞的线程
+    等到被唤醒时再一次性补上*/
     if(timer_ticks()%100 == 0)
     {
       renew_load_avg();
-      thread_all_renew();
+      decay_seconds++;
+      decay_history[decay_seconds % DECAY_HISTORY]
+        = div_fp (2*load_avg, add_int (2*load_avg, 1));
+      catch_up_recent_cpu(t);
+      renew_ready_threads();
     }
-    /*每4个timer_ticks更新一次所有线程的优先级*/
+    /*每4个timer_ticks更新一次正在运行的线程的优先级。ready队列中的线程的
+    recent_cpu和nice在两次衰减之间不会变化，优先级也就不会变化*/
     if(timer_ticks()%4 == 0)
-      renew_all_priority();
+      renew_priority(t);
   }
   /*Added by moon*/
 }
@@ -204,7 +274,10 @@ thread_create (const char *name, int priority,
   ASSERT (function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  /*Added by moon*/
+  /*不需要PAL_ZERO，init_thread会把struct thread清零，栈的部分不用清零*/
+  t = thread_page_get ();
+  /*Added by moon*/
   if (t == NULL)
     return TID_ERROR;
 
@@ -217,6 +290,10 @@ thread_create (const char *name, int priority,
      member cannot be observed. */
   old_level = intr_disable ();
 
+  /*Added by moon*/
+  tid_table_insert (t);
+  /*Added by moon*/
+
   /* Stack frame for kernel_thread(). */
   kf = alloc_frame (t, sizeof *kf);
   kf->eip = NULL;
@@ -234,10 +311,6 @@ thread_create (const char *name, int priority,
 
   intr_set_level (old_level);
 
-  /*Added by moon*/
-  t->ticks_blocked = 0; /*线程被创建时应该睡眠的时间为0*/
-  /*Added by moon*/
-
   /* Add to run queue. */
   thread_unblock (t);
   
@@ -261,6 +334,9 @@ thread_block (void)
   ASSERT (!intr_context ());
   ASSERT (intr_get_level () == INTR_OFF);
 
+  /*Added by moon*/
+  TRACE (TRACE_BLOCK, thread_current ()->tid, 0);
+  /*Added by moon*/
   thread_current ()->status = THREAD_BLOCKED;
   schedule ();
 }
@@ -282,11 +358,17 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
+  /*Added by moon*/
+  TRACE (TRACE_UNBLOCK, running_thread ()->tid, t->tid);
+  /*Added by moon*/
   /*list_push_back (&ready_list, &t->elem);*/
 
   /*Added by moon*/
-  /*按照优先级高优先的顺序将t放回ready队列中*/
-  list_insert_ordered (&ready_list, &t->elem, priority_higher, NULL);
+  /*mlfqs下被阻塞的线程的优先级没有被更新，入队前先补上*/
+  if(thread_mlfqs)
+    catch_up_priority (t);
+  /*将t放回它的优先级对应的ready队列的队尾*/
+  ready_push (t);
   /*Added by moon*/
 
   t->status = THREAD_READY;
@@ -342,6 +424,9 @@ thread_exit (void)
      when it calls thread_schedule_tail(). */
   intr_disable ();
   list_remove (&thread_current()->allelem);
+  /*Added by moon*/
+  list_remove (&thread_current()->tidelem);
+  /*Added by moon*/
   thread_current ()->status = THREAD_DYING;
   schedule ();
   NOT_REACHED ();
@@ -359,10 +444,14 @@ thread_yield (void)
 
   old_level = intr_disable ();
   if (cur != idle_thread) 
-    /*list_push_back (&ready_list, &cur->elem);*/
-    /*Added by moon*/
-     list_insert_ordered (&ready_list, &cur->elem, priority_higher, NULL);
-    /*Added by moon*/
+    {
+      /*list_push_back (&ready_list, &cur->elem);*/
+      /*Added by moon*/
+      if(thread_mlfqs)
+        renew_priority (cur);
+      ready_push (cur);
+      /*Added by moon*/
+    }
   cur->status = THREAD_READY;
   schedule ();
   intr_set_level (old_level);
@@ -385,6 +474,40 @@ thread_foreach (thread_action_func *func, void *aux)
     }
 }
 
+/*Added by moon*/
+/* Returns the thread whose tid is TID, or a null pointer if no
+   such thread exists or it has already exited.
+   This function must be called with interrupts off, and the
+   returned thread may only be used until interrupts are turned
+   back on, since it could exit at any time after that. */
+struct thread *
+thread_lookup (tid_t tid)
+{
+  struct list *bucket = tid_bucket (tid);
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (e = list_begin (bucket); e != list_end (bucket); e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, tidelem);
+      if (t->tid == tid)
+        return t;
+    }
+  return NULL;
+}
+
+/* Returns true if some thread is waiting in the run queue.
+   The idle thread uses this to stop background work as soon as
+   there is a thread to run.  The answer may be stale by the
+   time the caller looks at it. */
+bool
+thread_ready_waiting (void)
+{
+  return ready_mask != 0;
+}
+/*Added by moon*/
+
 /* Sets the current thread's priority to NEW_PRIORITY. */
 void
 thread_set_priority (int new_priority) 
@@ -409,13 +532,8 @@ thread_set_priority (int new_priority)
     /*Added by moon*/
     /*优先级改变了，判断下当前线程的优先级是否比ready队列中的线程的低，
     是的话就要放弃CPU*/
-    struct list_elem *p;
-    if(!list_empty(&ready_list))
-    {
-      p = list_begin (&ready_list);
-      if(thread_current()->priority < list_entry(p, struct thread, elem)->priority)
-        thread_yield();
-    }
+    if(thread_current()->priority < ready_max_priority ())
+      thread_yield();
   }
   /*Added by moon*/
 }
@@ -430,6 +548,16 @@ thread_set_other_priority (struct thread *curr, int new_priority, bool old)
     return;
   else
   {
+    /*如果设置的线程是ready的状态，要先把它从原来优先级的队列中取下，
+    改完优先级后再挂到新优先级的队列尾。正在等待信号量的线程也一样，
+    要在信号量的等待者堆中调整位置*/
+    bool ready = curr->status == THREAD_READY;
+    struct semaphore *sema = curr->status == THREAD_BLOCKED ? curr->sema_waiting : NULL;
+    if(ready)
+      ready_remove (curr);
+    else if(sema != NULL)
+      heap_remove (&sema->waiters, &curr->waitelem);
+
     if(curr->donated == false) /*没有被捐赠优先级*/
       curr->old_priority = curr->priority = new_priority;
     else if(old == true) /*需要设置old_priority*/
@@ -437,23 +565,16 @@ thread_set_other_priority (struct thread *curr, int new_priority, bool old)
     else /*需要设置priority*/
       curr->priority = new_priority;
 
-    /*如果设置的线程是ready的状态，因为优先级改变了，需要重新按照优先级的顺序放入ready队列中*/
-    if(curr->status == THREAD_READY)
-    {
-      list_remove (&curr->elem);
-      list_insert_ordered (&ready_list, &curr->elem, priority_higher, NULL);
-    }
+    if(ready)
+      ready_push (curr);
+    else if(sema != NULL)
+      heap_insert (&sema->waiters, &curr->waitelem);
     /*如果设置的线程是running的状态，因为优先级改变了，需要判断下它的优先级是否比ready队列中的
     线程的低，是的话就要放弃CPU*/
     else if(curr->status == THREAD_RUNNING)
     {
-      struct list_elem *p;
-      if(!list_empty(&ready_list))
-      {
-        p = list_begin (&ready_list);
-        if(thread_current()->priority < list_entry(p, struct thread, elem)->priority)
-          thread_yield();
-      }
+      if(thread_current()->priority < ready_max_priority ())
+        thread_yield();
     }
   }
 }
@@ -477,9 +598,8 @@ thread_set_nice (int nice)
   renew_recent_cpu(curr);
   renew_priority(curr);
 
-  struct list_elem* e = list_begin(&ready_list);
   /*如果优先级改变后当前线程的优先级比ready队列里的线程的低，就要让出CPU*/
-  if(curr->priority < list_entry(e, struct thread, elem)->priority)
+  if(curr->priority < ready_max_priority ())
     thread_yield();
 }
 
@@ -524,9 +644,20 @@ idle (void *idle_started_ UNUSED)
 
   for (;;) 
     {
+      /*Added by moon*/
+      /*没有别的线程要运行，趁机补充预先清零的页。timer中断唤醒的线程
+      不会抢占idle线程，所以palloc_zero_idle()每清零一页都检查有没有
+      线程就绪，有就马上返回，让出CPU*/
+      palloc_zero_idle ();
+      /*Added by moon*/
+
       /* Let someone else run. */
       intr_disable ();
       thread_block ();
+      /*Added by moon*/
+      /*没有线程可以运行，把timer切到one-shot模式，直到最早的睡眠线程到期*/
+      timer_idle_enter ();
+      /*Added by moon*/
 
       /* Re-enable interrupts and wait for the next one.
 
@@ -596,13 +727,17 @@ init_thread (struct thread *t, const char *name, int priority)
   /*Added by moon*/
   if(!thread_mlfqs)
     t->old_priority = priority;
-  list_init(&(t->locks));
+  heap_init(&(t->locks), lock_priority_higher, NULL);
+#ifdef VM
+  list_init (&t->mappings);
+#endif
   t->donated = false;
   t->blocked = NULL;
 
   if(thread_mlfqs)
   {
     t->nice = 0;
+    t->decay_seconds = decay_seconds;
     if(t == initial_thread) /*如果t是第一个创建的线程，recent_cpu就是0*/
       t->recent_cpu = 0;
     else 
@@ -632,10 +767,18 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void) 
 {
-  if (list_empty (&ready_list))
+  /*Added by moon*/
+  struct thread *t;
+
+  if (ready_mask == 0)
     return idle_thread;
-  else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+
+  /*取出最高优先级的非空队列的队头*/
+  t = list_entry (list_front (&ready_queue[ready_max_priority () - PRI_MIN]),
+                  struct thread, elem);
+  ready_remove (t);
+  return t;
+  /*Added by moon*/
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -680,7 +823,9 @@ thread_schedule_tail (struct thread *prev)
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) 
     {
       ASSERT (prev != cur);
-      palloc_free_page (prev);
+      /*Added by moon*/
+      thread_page_put (prev);
+      /*Added by moon*/
     }
 }
 
@@ -702,6 +847,15 @@ schedule (void)
   ASSERT (cur->status != THREAD_RUNNING);
   ASSERT (is_thread (next));
 
+  /*Added by moon*/
+  /*idle线程可能是被别的中断从hlt中唤醒的，这时one-shot的timer还没有到期，
+  要把它收回到下一个tick边界，不能让接下来运行的线程长时间收不到timer中断*/
+  if (cur == idle_thread)
+    timer_idle_exit ();
+  if (cur != next)
+    TRACE (TRACE_SWITCH, cur->tid, next->tid);
+  /*Added by moon*/
+
   if (cur != next)
     prev = switch_threads (cur, next);
   thread_schedule_tail (prev);
@@ -722,15 +876,64 @@ allocate_tid (void)
 }
 
 /*Added by moon*/
-/*如果参数的线程是被阻塞的状态，则应该睡眠的时间-1，如果应该睡眠的时间为0就unblock*/
-void 
-checkInvoke(struct thread* t, void* aux UNUSED){
-  if(t->status == THREAD_BLOCKED && t->ticks_blocked > 0){
-    t->ticks_blocked -- ;
-    if(t->ticks_blocked == 0){
-      thread_unblock(t);
+/*返回tid所在的线程表的桶*/
+static struct list *
+tid_bucket (tid_t tid)
+{
+  return &tid_table[(unsigned) tid % TID_BUCKET_CNT];
+}
+
+/*把已经分配好tid的线程T加入线程表，必须在关中断的情况下调用*/
+static void
+tid_table_insert (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->tid != TID_ERROR);
+
+  list_push_back (tid_bucket (t->tid), &t->tidelem);
+}
+
+/*取一个用来存放新线程的页，缓存中有就直接用，否则向palloc申请。
+返回的页的内容是未初始化的*/
+static struct thread *
+thread_page_get (void)
+{
+  struct thread *t = NULL;
+  enum intr_level old_level;
+
+  old_level = spin_lock (&thread_cache_lock);
+  if (thread_cache_cnt > 0)
+    t = thread_cache[--thread_cache_cnt];
+  spin_unlock (&thread_cache_lock, old_level);
+
+  if (t == NULL)
+    t = palloc_get_page (0);
+  return t;
+}
+
+/*回收已经死亡的线程T的页。缓存没满就留着给下一个thread_create用，
+满了才还给palloc*/
+static void
+thread_page_put (struct thread *t)
+{
+  enum intr_level old_level;
+  bool cached = false;
+
+  /*栈溢出会破坏magic，不能把这样的页留下来继续用*/
+  ASSERT (is_thread (t));
+  /*清掉magic，之后还拿着这个指针的代码会在is_thread()的检查上失败*/
+  t->magic = 0;
+
+  old_level = spin_lock (&thread_cache_lock);
+  if (thread_cache_cnt < THREAD_CACHE_MAX)
+    {
+      thread_cache[thread_cache_cnt++] = t;
+      cached = true;
     }
-  }
+  spin_unlock (&thread_cache_lock, old_level);
+
+  if (!cached)
+    palloc_free_page (t);
 }
 
 /*判断两个list_elem哪个对应的thread的优先级高*/
@@ -745,13 +948,13 @@ priority_higher (const struct list_elem *a, const struct list_elem *b,void *aux
   return(a_thread->priority > b_thread->priority);
 }
 
-/*获得当前ready_list大小（再加上正在运行的线程的个数），但是不包括idle_thread*/
+/*获得当前ready队列大小（再加上正在运行的线程的个数），但是不包括idle_thread*/
 int64_t get_ready_threads (void)
 {
   if(thread_current() != idle_thread)
-    return list_size(&ready_list)+1;
+    return ready_cnt+1;
   else
-    return list_size(&ready_list);
+    return ready_cnt;
 }
 
 /*计算load_avg*/
@@ -770,13 +973,94 @@ void renew_recent_cpu (struct thread* t)
                            t->recent_cpu), t->nice);
 }
 
-/*重新计算所有线程的recent_cpu*/
-void thread_all_renew(void)
+/*把被阻塞期间错过的recent_cpu衰减补齐到当前这一秒，然后重新计算优先级。
+t不能在ready队列中*/
+void catch_up_priority (struct thread *t)
+{
+  ASSERT (t->status != THREAD_READY);
+
+  catch_up_recent_cpu (t);
+  renew_priority (t);
+}
+
+/*补齐t从上次衰减以来错过的recent_cpu衰减。记录中还保留着的最近DECAY_HISTORY
+秒按照每一秒的系数逐秒衰减，结果和每秒都衰减一次完全相同；更早的部分用记录中
+最早的系数按等比数列的闭式一次算完：
+  recent_cpu = c^k*recent_cpu + nice*(1-c^k)/(1-c)*/
+static void
+catch_up_recent_cpu (struct thread *t)
 {
-  thread_foreach(renew_recent_cpu,NULL);
+  int missed, s;
+
+  if (t == idle_thread)
+    return;
+
+  missed = decay_seconds - t->decay_seconds;
+  if (missed > DECAY_HISTORY)
+    {
+      int64_t c = decay_history[(decay_seconds - DECAY_HISTORY + 1)
+                                % DECAY_HISTORY];
+      int64_t ck = pow_fp (c, missed - DECAY_HISTORY);
+      int64_t one = convert_to_fp (1);
+
+      t->recent_cpu = mul_fp (ck, t->recent_cpu)
+                      + t->nice * div_fp (one - ck, one - c);
+      missed = DECAY_HISTORY;
+    }
+  for (s = decay_seconds - missed + 1; s <= decay_seconds; s++)
+    t->recent_cpu = add_int (mul_fp (decay_history[s % DECAY_HISTORY],
+                                     t->recent_cpu), t->nice);
+  t->decay_seconds = decay_seconds;
 }
 
-/*根据recent_cpu和nice的值来更新优先级*/
+/*每秒一次，对ready队列中的线程补上这一秒的recent_cpu衰减并重新计算优先级。
+先把所有线程按优先级从高到低取下来，再依次按新的优先级入队，这样同一优先级
+中的线程仍然保持原来的先后顺序*/
+static void
+renew_ready_threads (void)
+{
+  struct list batch;
+  int pri;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_init (&batch);
+  for (pri = PRI_MAX; pri >= PRI_MIN; pri--)
+    {
+      struct list *q = &ready_queue[pri - PRI_MIN];
+      if (!list_empty (q))
+        list_splice (list_end (&batch), list_begin (q), list_end (q));
+    }
+  ready_mask = 0;
+  ready_cnt = 0;
+
+  while (!list_empty (&batch))
+    {
+      struct thread *t = list_entry (list_pop_front (&batch),
+                                     struct thread, elem);
+      catch_up_recent_cpu (t);
+      renew_priority (t);
+      ready_push (t);
+    }
+}
+
+/*计算定点数x的n次幂，n>=0*/
+static int64_t
+pow_fp (int64_t x, int n)
+{
+  int64_t result = convert_to_fp (1);
+
+  while (n > 0)
+    {
+      if (n & 1)
+        result = mul_fp (result, x);
+      x = mul_fp (x, x);
+      n >>= 1;
+    }
+  return result;
+}
+
+/*根据recent_cpu和nice的值来更新优先级。t不能在ready队列中，否则要先把它取下来*/
 void renew_priority (struct thread* t)
 {
   if(t != idle_thread)
@@ -791,12 +1075,51 @@ void renew_priority (struct thread* t)
   }
 }
 
-/*更新所有线程的优先级（不包括idle_thread）*/
-void renew_all_priority (void)
+/*将t挂到它的优先级对应的ready队列的队尾，并在ready_mask中置位*/
+static void
+ready_push (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+  list_push_back (&ready_queue[t->priority - PRI_MIN], &t->elem);
+  ready_mask |= (uint64_t) 1 << (t->priority - PRI_MIN);
+  ready_cnt++;
+}
+
+/*将ready状态的t从它所在的队列中取下，队列变空时清除ready_mask中的对应位*/
+static void
+ready_remove (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_remove (&t->elem);
+  if (list_empty (&ready_queue[t->priority - PRI_MIN]))
+    ready_mask &= ~((uint64_t) 1 << (t->priority - PRI_MIN));
+  ready_cnt--;
+}
+
+/*用bsr指令找出ready_mask中最高的置位，返回ready队列中最高的优先级，
+ready队列为空时返回PRI_MIN-1*/
+static int
+ready_max_priority (void)
 {
-  thread_foreach(renew_priority,NULL);
-  /*要保证ready队列是按照优先级高优先的顺序排列的*/
-  list_sort (&ready_list, priority_higher, NULL);
+  uint32_t hi = ready_mask >> 32;
+  uint32_t lo = (uint32_t) ready_mask;
+  uint32_t bit;
+
+  if (hi != 0)
+    {
+      asm ("bsrl %1, %0" : "=r" (bit) : "rm" (hi));
+      return PRI_MIN + 32 + bit;
+    }
+  else if (lo != 0)
+    {
+      asm ("bsrl %1, %0" : "=r" (bit) : "rm" (lo));
+      return PRI_MIN + bit;
+    }
+  else
+    return PRI_MIN - 1;
 }
 
 /*Added by moon*/
@@ -2,8 +2,15 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <hash.h>
+#include <heap.h>
 #include <list.h>
 #include <stdint.h>
+/*Added by moon*/
+#ifdef VM
+#include "vm/page.h"
+#endif
+/*Added by moon*/
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -75,11 +82,12 @@ typedef int tid_t;
    set to THREAD_MAGIC.  Stack overflow will normally change this
    value, triggering the assertion. */
 /* The `elem' member has a dual purpose.  It can be an element in
-   the run queue (thread.c), or it can be an element in a
-   semaphore wait list (synch.c).  It can be used these two ways
-   only because they are mutually exclusive: only a thread in the
-   ready state is on the run queue, whereas only a thread in the
-   blocked state is on a semaphore wait list. */
+   the run queue (thread.c), or it can be an element in the sleep
+   list (timer.c).  It can be used these two ways only because
+   they are mutually exclusive: only a thread in the ready state
+   is on the run queue, whereas only a thread in the blocked
+   state is on the sleep list.  Semaphore waiters are kept in a
+   heap through the separate `waitelem' member. */
 struct thread
   {
     /* Owned by thread.c. */
@@ -91,7 +99,7 @@ struct thread
 
     /*Added by moon*/
     int old_priority;   /*原来的优先级*/
-    struct list locks;  /*当前线程持有的锁*/
+    struct heap locks;  /*当前线程持有的锁，按锁的优先级组织成堆*/
     bool donated;       /*当前线程是否被捐赠过优先级*/
     struct lock *blocked; /*当前线程正在被什么锁所block*/
     /*Added by moon*/
@@ -99,21 +107,44 @@ struct thread
     /*Added by moon*/
     int32_t nice;      /*mlfqs中和线程优先级相关的变量*/
     int64_t recent_cpu; /*最近使用CPU的时间*/
+    int decay_seconds;  /*recent_cpu已经衰减到了第几秒*/
     /*Added by moon*/
 
     struct list_elem allelem;           /* List element for all threads list. */
+    /*Added by moon*/
+    struct list_elem tidelem;           /*在按tid索引的线程表中的元素*/
+    /*Added by moon*/
 
-    /* Shared between thread.c and synch.c. */
+    /* Shared between thread.c and timer.c. */
     struct list_elem elem;              /* List element. */
 
     /*Added by moon*/
-    int ticks_blocked; /*线程应该睡眠的时间*/
+    /* Owned by synch.c. */
+    struct heap_elem waitelem;          /*在信号量等待者堆中的元素*/
+    unsigned wait_seq;                  /*开始等待时的序号*/
+    struct semaphore *sema_waiting;     /*正在等待的信号量*/
+    /*Added by moon*/
+
+    /*Added by moon*/
+    int64_t wakeup_ticks; /*线程睡眠结束时的时刻（timer_ticks的绝对值）*/
     /*Added by moon*/
 
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
 #endif
+/*Added by moon*/
+#ifdef VM
+    /* Owned by vm/page.c. */
+    struct hash pages;                  /* Supplemental page table. */
+    struct file *exec_file;             /* Executable, for lazy loading. */
+    struct fault_stream stream;         /* Faults outside mappings. */
+
+    /* Owned by vm/mmap.c. */
+    struct list mappings;               /* Memory-mapped files. */
+    int next_mapid;                     /* Identifier of next mapping. */
+#endif
+/*Added by moon*/
 
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
@@ -146,6 +177,10 @@ void thread_yield (void);
 /* Performs some operation on thread t, given auxiliary data AUX. */
 typedef void thread_action_func (struct thread *t, void *aux);
 void thread_foreach (thread_action_func *, void *);
+/*Added by moon*/
+struct thread *thread_lookup (tid_t);
+bool thread_ready_waiting (void);
+/*Added by moon*/
 
 int thread_get_priority (void);
 void thread_set_priority (int);
@@ -157,16 +192,13 @@ int thread_get_load_avg (void);
 
 /*Added by moon*/
 
-/*如果参数的线程是被阻塞的状态，则应该睡眠的时间-1，如果应该睡眠的时间为0就unblock*/
-void checkInvoke(struct thread*, void* aux);
-
 /*可以设置除了当前线程外其他线程优先级的函数,用old变量来区分设置old_priority还是priority*/
 void thread_set_other_priority (struct thread *, int, bool);
 
 /*判断两个list_elem哪个对应的thread的优先级高*/
 bool priority_higher (const struct list_elem *, const struct list_elem *,void *aux);
 
-/*获得当前ready_list大小（再加上正在运行的线程的个数），但是不包括idle_thread*/
+/*获得当前ready队列大小（再加上正在运行的线程的个数），但是不包括idle_thread*/
 int64_t get_ready_threads (void);
 
 /*计算load_avg*/
@@ -175,14 +207,11 @@ void renew_load_avg(void);
 /*计算recent_cpu*/
 void renew_recent_cpu (struct thread* t);
 
-/*重新计算所有线程的recent_cpu*/
-void thread_all_renew(void);
+/*补上被阻塞的线程错过的recent_cpu衰减并重新计算优先级*/
+void catch_up_priority (struct thread *t);
 
 /*根据recent_cpu和nice的值来更新优先级*/
 void renew_priority (struct thread* t);
 
-/*更新所有线程的优先级（不包括idle_thread）*/
-void renew_all_priority (void);
-
 /*Added by moon*/
 #endif /* threads/thread.h */
@@ -0,0 +1,113 @@
+#include "threads/trace.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <round.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/*Added by moon*/
+/* One recorded event. */
+struct trace_entry
+  {
+    uint64_t tsc;               /* Time stamp counter at the event. */
+    int32_t tid;                /* Thread the event is about. */
+    uint32_t arg;               /* Type-specific argument. */
+    uint8_t type;               /* An enum trace_type. */
+  };
+
+/*环形缓冲区能保存的事件数和占用的页数。事件数必须是2的幂，
+这样32位的计数回绕时取模的结果仍然连续*/
+#define TRACE_CAPACITY 4096
+#define TRACE_PAGES DIV_ROUND_UP (TRACE_CAPACITY * sizeof (struct trace_entry), \
+                                  PGSIZE)
+
+/* True while events are being recorded. */
+bool trace_enabled;
+
+static struct trace_entry *trace_buf;   /*环形缓冲区*/
+static uint32_t trace_head;             /*已经分配出去的事件总数*/
+
+/*开始记录时的tsc和timer tick，用来在输出时换算tsc的频率*/
+static uint64_t start_tsc;
+static int64_t start_ticks;
+
+static const char *type_names[] =
+  {"switch", "block", "unblock", "sema_down", "sema_up", "lock_acquire"};
+
+/*读取时间戳计数器*/
+static inline uint64_t
+rdtsc (void)
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+/* Allocates the ring buffer and starts recording events.  Must
+   be called after the page allocator is initialized. */
+void
+trace_init (void)
+{
+  trace_buf = palloc_get_multiple (PAL_ZERO, TRACE_PAGES);
+  if (trace_buf == NULL)
+    {
+      printf ("trace: cannot allocate %zu pages, tracing disabled\n",
+              (size_t) TRACE_PAGES);
+      return;
+    }
+  start_tsc = rdtsc ();
+  start_ticks = timer_ticks ();
+  trace_enabled = true;
+}
+
+/* Records an event of TYPE for thread TID with argument ARG.
+   A slot is claimed with an atomic fetch-and-add on the head
+   index, so recording never takes a lock or disables interrupts
+   and may be called from any context.  Once the buffer is full
+   the oldest events are overwritten. */
+void
+trace_record (enum trace_type type, int tid, uint32_t arg)
+{
+  struct trace_entry *e;
+  uint32_t slot = 1;
+
+  asm volatile ("lock xaddl %0, %1" : "+r" (slot), "+m" (trace_head)
+                : : "memory");
+  e = &trace_buf[slot % TRACE_CAPACITY];
+  e->tsc = rdtsc ();
+  e->tid = tid;
+  e->arg = arg;
+  e->type = type;
+}
+
+/* Stops recording and prints the events in the buffer, oldest
+   first, as CSV lines prefixed by "trace,".  The "trace-hz" line
+   gives the measured time stamp counter frequency, for
+   converting timestamps to wall-clock time. */
+void
+trace_dump (void)
+{
+  uint32_t first, i;
+  int64_t ticks;
+
+  if (!trace_enabled)
+    return;
+  trace_enabled = false;
+
+  ticks = timer_ticks () - start_ticks;
+  if (ticks > 0)
+    printf ("trace-hz,%"PRIu64"\n",
+            (rdtsc () - start_tsc) * TIMER_FREQ / ticks);
+  printf ("trace,tsc,event,tid,arg\n");
+
+  first = trace_head > TRACE_CAPACITY ? trace_head - TRACE_CAPACITY : 0;
+  for (i = first; i != trace_head; i++)
+    {
+      const struct trace_entry *e = &trace_buf[i % TRACE_CAPACITY];
+      printf ("trace,%"PRIu64",%s,%"PRId32",%"PRIu32"\n",
+              e->tsc, type_names[e->type], e->tid, e->arg);
+    }
+}
+/*Added by moon*/
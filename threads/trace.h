@@ -0,0 +1,47 @@
+#ifndef THREADS_TRACE_H
+#define THREADS_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*Added by moon*/
+/* Scheduler event tracer.
+
+   When enabled with the "-trace" kernel command-line option,
+   scheduler and synchronization events are timestamped with
+   rdtsc and recorded into a fixed-size ring buffer.  The buffer
+   keeps the most recent TRACE_CAPACITY events and is dumped to
+   the console (and thus the serial port) in CSV form at
+   shutdown.  utils/pintos-trace turns the dump into per-thread
+   timelines and wakeup-latency histograms. */
+
+/* Kinds of trace events. */
+enum trace_type
+  {
+    TRACE_SWITCH,               /* TID switched to thread ARG. */
+    TRACE_BLOCK,                /* TID blocked itself. */
+    TRACE_UNBLOCK,              /* TID made thread ARG ready. */
+    TRACE_SEMA_DOWN,            /* TID downed semaphore ARG. */
+    TRACE_SEMA_UP,              /* TID upped semaphore ARG. */
+    TRACE_LOCK_ACQUIRE          /* TID is acquiring lock ARG. */
+  };
+
+/* True while events are being recorded. */
+extern bool trace_enabled;
+
+void trace_init (void);
+void trace_record (enum trace_type, int tid, uint32_t arg);
+void trace_dump (void);
+
+/* Records an event of TYPE for thread TID with argument ARG, if
+   tracing is enabled.  Costs one test and branch otherwise. */
+#define TRACE(TYPE, TID, ARG)                                   \
+        do                                                      \
+          {                                                     \
+            if (trace_enabled)                                  \
+              trace_record (TYPE, TID, (uint32_t) (ARG));       \
+          }                                                     \
+        while (0)
+/*Added by moon*/
+
+#endif /* threads/trace.h */
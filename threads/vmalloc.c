@@ -0,0 +1,163 @@
+#include "threads/vmalloc.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdint.h>
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/*Added by moon*/
+/*区域中每一页的虚拟地址是否被占用。每次分配后面都多占一页不映射的
+保护页，越界访问会引起缺页，而不是写到别的缓冲区里*/
+static struct bitmap *used_pages;
+
+/*每次分配的最后一页，vfree()靠它确定要释放的范围*/
+static struct bitmap *last_pages;
+
+/*保护used_pages和last_pages*/
+static struct lock vmalloc_lock;
+
+static uint32_t *lookup_pte (const void *vaddr);
+static void invalidate (const void *vaddr);
+
+/* Reserves the vmalloc region and allocates its page tables in
+   init_page_dir.  Must be called after paging_init() and before
+   any process page directory is created. */
+void
+vmalloc_init (void)
+{
+  uint8_t *va;
+
+  ASSERT ((uint8_t *) ptov (init_ram_pages * PGSIZE)
+          <= (uint8_t *) VMALLOC_BASE);
+
+  lock_init (&vmalloc_lock);
+  used_pages = bitmap_create (VMALLOC_PAGES);
+  last_pages = bitmap_create (VMALLOC_PAGES);
+  if (used_pages == NULL || last_pages == NULL)
+    PANIC ("vmalloc: cannot allocate bitmaps");
+
+  /*pagedir_create()复制init_page_dir中内核部分的页目录项，所以页表要在
+  这里一次建好，之后新建的映射所有的页目录都能看到*/
+  for (va = VMALLOC_BASE; va < (uint8_t *) VMALLOC_BASE
+                               + (size_t) VMALLOC_PAGES * PGSIZE;
+       va += PTSPAN)
+    {
+      uint32_t *pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+      init_page_dir[pd_no (va)] = pde_create (pt);
+    }
+}
+
+/* Allocates PAGE_CNT pages of kernel memory that are contiguous
+   in virtual memory but not necessarily in physical memory, and
+   returns the address of the first.  FLAGS are interpreted as
+   for palloc_get_page(), except that PAL_USER is not allowed.
+   Returns a null pointer if the region has no range large
+   enough or if the kernel pool runs out of pages, unless
+   PAL_ASSERT is set, in which case the kernel panics. */
+void *
+vmalloc (size_t page_cnt, enum palloc_flags flags)
+{
+  size_t idx, i;
+  uint8_t *base;
+
+  ASSERT (!(flags & PAL_USER));
+
+  if (page_cnt == 0 || used_pages == NULL)
+    return NULL;
+
+  lock_acquire (&vmalloc_lock);
+  idx = bitmap_scan_and_flip (used_pages, 0, page_cnt + 1, false);
+  if (idx != BITMAP_ERROR)
+    bitmap_mark (last_pages, idx + page_cnt - 1);
+  lock_release (&vmalloc_lock);
+  if (idx == BITMAP_ERROR)
+    {
+      if (flags & PAL_ASSERT)
+        PANIC ("vmalloc: out of virtual address space");
+      return NULL;
+    }
+
+  base = (uint8_t *) VMALLOC_BASE + idx * PGSIZE;
+  for (i = 0; i < page_cnt; i++)
+    {
+      void *kpage = palloc_get_page (flags & ~PAL_ASSERT);
+      if (kpage == NULL)
+        {
+          vfree (base);
+          if (flags & PAL_ASSERT)
+            PANIC ("vmalloc: out of pages");
+          return NULL;
+        }
+      *lookup_pte (base + i * PGSIZE) = pte_create_kernel (kpage, true);
+    }
+  return base;
+}
+
+/* Frees the pages starting at BASE, which must have been
+   returned by vmalloc(). */
+void
+vfree (void *base)
+{
+  size_t idx, last, i;
+
+  if (base == NULL)
+    return;
+  ASSERT (is_vmalloc_vaddr (base));
+  ASSERT (pg_ofs (base) == 0);
+
+  idx = pg_no (base) - pg_no (VMALLOC_BASE);
+  lock_acquire (&vmalloc_lock);
+  for (last = idx; !bitmap_test (last_pages, last); last++)
+    ASSERT (bitmap_test (used_pages, last));
+  lock_release (&vmalloc_lock);
+
+  /*先撤销映射并释放物理页，再把虚拟地址还回去，免得别人拿到还映射着
+  旧页的地址。分配失败退回时后面的页还没有映射*/
+  for (i = idx; i <= last; i++)
+    {
+      uint8_t *va = (uint8_t *) VMALLOC_BASE + i * PGSIZE;
+      uint32_t *pte = lookup_pte (va);
+
+      if (*pte & PTE_P)
+        {
+          palloc_free_page (pte_get_page (*pte));
+          *pte = 0;
+          invalidate (va);
+        }
+    }
+
+  /*连同后面的保护页一起释放*/
+  lock_acquire (&vmalloc_lock);
+  bitmap_reset (last_pages, last);
+  bitmap_set_multiple (used_pages, idx, last - idx + 2, false);
+  lock_release (&vmalloc_lock);
+}
+
+/* Returns true if VADDR lies in the vmalloc region. */
+bool
+is_vmalloc_vaddr (const void *vaddr)
+{
+  return (const uint8_t *) vaddr >= (const uint8_t *) VMALLOC_BASE
+         && (const uint8_t *) vaddr < ((const uint8_t *) VMALLOC_BASE
+                                       + (size_t) VMALLOC_PAGES * PGSIZE);
+}
+
+/*返回区域中虚拟地址VADDR的页表项*/
+static uint32_t *
+lookup_pte (const void *vaddr)
+{
+  uint32_t *pt = pde_get_pt (init_page_dir[pd_no (vaddr)]);
+  return &pt[pt_no (vaddr)];
+}
+
+/*使TLB中VADDR的缓存失效。页表是所有页目录共享的，所以只需要在当前
+CPU上做一次*/
+static void
+invalidate (const void *vaddr)
+{
+  asm volatile ("invlpg (%0)" : : "r" (vaddr) : "memory");
+}
+/*Added by moon*/
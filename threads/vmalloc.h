@@ -0,0 +1,33 @@
+#ifndef THREADS_VMALLOC_H
+#define THREADS_VMALLOC_H
+
+/*Added by moon*/
+#include <stdbool.h>
+#include <stddef.h>
+#include "threads/palloc.h"
+
+/* Virtually contiguous kernel allocations.
+
+   The kernel maps all of physical memory at PHYS_BASE, so a
+   buffer obtained from palloc_get_multiple() must consist of
+   physically contiguous pages, which become scarce as memory
+   fragments.  vmalloc() instead takes individual pages from the
+   kernel pool, wherever they are, and maps them at consecutive
+   addresses in a reserved kernel virtual region.
+
+   The page tables for the whole region are allocated when it is
+   initialized and are shared by every page directory, so a
+   vmalloc()'d buffer is visible in all processes. */
+
+/* Reserved region: VMALLOC_PAGES pages starting at VMALLOC_BASE,
+   well above where physical memory is mapped. */
+#define VMALLOC_BASE ((void *) 0xf0000000)
+#define VMALLOC_PAGES 16384
+
+void vmalloc_init (void);
+void *vmalloc (size_t page_cnt, enum palloc_flags);
+void vfree (void *);
+bool is_vmalloc_vaddr (const void *);
+/*Added by moon*/
+
+#endif /* threads/vmalloc.h */
@@ -4,6 +4,11 @@
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+/*Added by moon*/
+#ifdef VM
+#include "vm/page.h"
+#endif
+/*Added by moon*/
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -148,6 +153,16 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
+  /*Added by moon*/
+#ifdef VM
+  /*访问的是还没有调入内存的页时，把它调入后返回，重新执行出错的指令；
+  写的是和fork出来的进程共享的页时，复制一份后返回。
+  只有从用户态进入时f->esp才是用户栈指针*/
+  if (page_fault_in (fault_addr, write, user ? f->esp : NULL))
+    return;
+#endif
+  /*Added by moon*/
+
   /* To implement virtual memory, delete the rest of the function
      body, and replace it with code that brings in the page to
      which fault_addr refers. */
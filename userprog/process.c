@@ -15,11 +15,32 @@
 #include "threads/init.h"
 #include "threads/interrupt.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+/*Added by moon*/
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
+/*Added by moon*/
 
 static thread_func start_process NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
+/*Added by moon*/
+#ifdef VM
+/*process_fork()传给子进程的参数*/
+struct fork_args
+  {
+    struct intr_frame if_;      /*父进程进入系统调用时的中断帧*/
+    struct thread *parent;      /*父进程*/
+    struct semaphore done;      /*子进程复制完地址空间后up*/
+    bool success;               /*复制是否成功*/
+  };
+
+static thread_func start_fork NO_RETURN;
+#endif
+/*Added by moon*/
 
 /* Starts a new thread running a user program loaded from
    FILENAME.  The new thread may be scheduled (and may even exit)
@@ -76,6 +97,75 @@ start_process (void *file_name_)
   NOT_REACHED ();
 }
 
+/*Added by moon*/
+#ifdef VM
+/* Creates a child of the current process with a copy of its
+   address space and returns the child's thread id, or
+   TID_ERROR if the child cannot be created.  F is the interrupt
+   frame of the system call; the child resumes from it as if the
+   system call had returned 0.  No memory is copied: the child
+   shares the parent's frames copy-on-write. */
+tid_t
+process_fork (struct intr_frame *f)
+{
+  struct fork_args args;
+  tid_t tid;
+
+  args.if_ = *f;
+  args.parent = thread_current ();
+  sema_init (&args.done, 0);
+  args.success = false;
+
+  tid = thread_create (thread_name (), PRI_DEFAULT, start_fork, &args);
+  if (tid == TID_ERROR)
+    return TID_ERROR;
+
+  /*子进程复制地址空间期间父进程不能运行，否则它的页表会被改动*/
+  sema_down (&args.done);
+  return args.success ? tid : TID_ERROR;
+}
+
+/*fork出来的子进程的线程函数，复制父进程的地址空间后从父进程的系统调用
+返回*/
+static void
+start_fork (void *args_)
+{
+  struct fork_args *args = args_;
+  struct thread *t = thread_current ();
+  struct thread *parent = args->parent;
+  struct intr_frame if_ = args->if_;
+  bool success = false;
+
+  /*和load()一样，补充页表要在页目录之前建立*/
+  if (!page_table_init ())
+    goto done;
+  t->pagedir = pagedir_create ();
+  if (t->pagedir == NULL)
+    {
+      /*没有页目录时process_exit()不会销毁补充页表，只能在这里销毁*/
+      page_table_destroy ();
+      goto done;
+    }
+  process_activate ();
+
+  t->exec_file = file_reopen (parent->exec_file);
+  if (t->exec_file == NULL)
+    goto done;
+  success = page_table_copy (parent) && mmap_copy (parent);
+
+ done:
+  args->success = success;
+  sema_up (&args->done);
+  if (!success)
+    thread_exit ();
+
+  if_.eax = 0;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+#endif
+/*Added by moon*/
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
@@ -103,6 +193,16 @@ process_exit (void)
   pd = cur->pagedir;
   if (pd != NULL) 
     {
+      /*Added by moon*/
+#ifdef VM
+      /*先撤销文件映射，被修改过的页写回文件，再撤销补充页表中其他的映射
+      并释放帧，剩下的页目录里就只有页表本身了*/
+      mmap_unmap_all ();
+      page_table_destroy ();
+      file_close (cur->exec_file);
+      cur->exec_file = NULL;
+#endif
+      /*Added by moon*/
       /* Correct ordering here is crucial.  We must set
          cur->pagedir to NULL before switching page directories,
          so that a timer interrupt can't switch back to the
@@ -215,10 +315,26 @@ load (const char *file_name, void (**eip) (void), void **esp)
   bool success = false;
   int i;
 
+  /*Added by moon*/
+#ifdef VM
+  /*补充页表要在页目录之前建立，process_exit()看到页目录就会销毁它*/
+  if (!page_table_init ())
+    goto done;
+#endif
+  /*Added by moon*/
+
   /* Allocate and activate page directory. */
   t->pagedir = pagedir_create ();
   if (t->pagedir == NULL) 
-    goto done;
+    {
+      /*Added by moon*/
+#ifdef VM
+      /*没有页目录时process_exit()不会销毁补充页表，只能在这里销毁*/
+      page_table_destroy ();
+#endif
+      /*Added by moon*/
+      goto done;
+    }
   process_activate ();
 
   /* Open executable file. */
@@ -312,6 +428,16 @@ load (const char *file_name, void (**eip) (void), void **esp)
 
  done:
   /* We arrive here whether the load is successful or not. */
+  /*Added by moon*/
+#ifdef VM
+  /*可执行文件的页是在缺页时才读入的，文件要一直开着直到进程退出*/
+  if (t->pagedir != NULL)
+    {
+      t->exec_file = file;
+      return success;
+    }
+#endif
+  /*Added by moon*/
   file_close (file);
   return success;
 }
@@ -387,6 +513,32 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
+  /*Added by moon*/
+#ifdef VM
+  /*只在补充页表中记下每一页的内容从哪里来，等进程访问到时再读入，
+  完全是零的页（BSS）不用读文件*/
+  while (read_bytes > 0 || zero_bytes > 0) 
+    {
+      size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
+      size_t page_zero_bytes = PGSIZE - page_read_bytes;
+      bool ok;
+
+      if (page_read_bytes > 0)
+        ok = page_add_file (upage, file, ofs, page_read_bytes, writable);
+      else
+        ok = page_add_zero (upage, writable);
+      if (!ok)
+        return false;
+
+      read_bytes -= page_read_bytes;
+      zero_bytes -= page_zero_bytes;
+      ofs += page_read_bytes;
+      upage += PGSIZE;
+    }
+  return true;
+#endif
+  /*Added by moon*/
+
   file_seek (file, ofs);
   while (read_bytes > 0 || zero_bytes > 0) 
     {
@@ -432,6 +584,19 @@ setup_stack (void **esp)
   uint8_t *kpage;
   bool success = false;
 
+  /*Added by moon*/
+#ifdef VM
+  /*栈顶的页马上就要写入参数，直接调入内存。更低的页在缺页时按需增长*/
+  uint8_t *upage = ((uint8_t *) PHYS_BASE) - PGSIZE;
+  if (page_add_zero (upage, true) && page_in (page_lookup (upage)))
+    {
+      *esp = PHYS_BASE;
+      return true;
+    }
+  return false;
+#endif
+  /*Added by moon*/
+
   kpage = palloc_get_page (PAL_USER | PAL_ZERO);
   if (kpage != NULL) 
     {
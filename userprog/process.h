@@ -7,5 +7,11 @@ tid_t process_execute (const char *file_name);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
+/*Added by moon*/
+#ifdef VM
+struct intr_frame;
+tid_t process_fork (struct intr_frame *);
+#endif
+/*Added by moon*/
 
 #endif /* userprog/process.h */
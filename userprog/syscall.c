@@ -3,8 +3,21 @@
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+/*Added by moon*/
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
+/*Added by moon*/
 
 static void syscall_handler (struct intr_frame *);
+/*Added by moon*/
+#ifdef VM
+static bool get_user_int (const int *uaddr, const void *esp, int *value);
+#endif
+/*Added by moon*/
 
 void
 syscall_init (void) 
@@ -13,8 +26,55 @@ syscall_init (void)
 }
 
 static void
-syscall_handler (struct intr_frame *f UNUSED) 
+syscall_handler (struct intr_frame *f) 
 {
+  /*Added by moon*/
+#ifdef VM
+  /*系统调用号在用户栈顶，那一页可能还没调入或者已经被换出*/
+  int nr;
+  if (!get_user_int (f->esp, f->esp, &nr))
+    thread_exit ();
+  if (nr == SYS_FORK)
+    {
+      f->eax = process_fork (f);
+      return;
+    }
+#else
+  (void) f;
+#endif
+  /*Added by moon*/
   printf ("system call!\n");
   thread_exit ();
 }
+
+/*Added by moon*/
+#ifdef VM
+/* Reads the int at user virtual address UADDR into *VALUE,
+   first bringing each page it spans into memory through the
+   supplemental page table.  ESP is the user stack pointer, used
+   to tell stack growth from a stray access.  Returns true if
+   successful, false if UADDR is not a valid user address. */
+static bool
+get_user_int (const int *uaddr, const void *esp, int *value)
+{
+  const uint8_t *first = (const uint8_t *) uaddr;
+  const uint8_t *last = first + sizeof *value - 1;
+  uint32_t *pd = thread_current ()->pagedir;
+
+  if (!is_user_vaddr (last))
+    return false;
+  if (pagedir_get_page (pd, first) == NULL
+      && !page_fault_in (first, false, esp))
+    return false;
+  if (pg_no (last) != pg_no (first)
+      && pagedir_get_page (pd, last) == NULL
+      && !page_fault_in (last, false, esp))
+    return false;
+
+  /*调入之后这一页仍可能被换出，这时内核态的缺页会从补充页表把它
+  再调入，不会失败*/
+  *value = *uaddr;
+  return true;
+}
+#endif
+/*Added by moon*/
@@ -0,0 +1,790 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+
+/*Added by moon*/
+/*所有已经分配出去的帧*/
+static struct list frame_table;
+
+/*页缓存，按(inode, 偏移, 字节数)索引缓存文件内容的帧*/
+static struct hash page_cache;
+
+/*时钟算法的指针，指向下一个要检查的帧，为NULL时从表头开始*/
+static struct list_elem *clock_hand;
+
+/*保护frame_table、page_cache、clock_hand、帧的各个成员，以及页和帧之间的
+对应关系。帧的I/O是在释放锁之后进行的，这期间帧被标记为busy*/
+static struct lock frame_lock;
+
+/*有帧的I/O完成时广播，要等某个帧的I/O完成的线程在上面等待*/
+static struct condition io_done;
+
+/*后台回收线程一次最多写回的帧数*/
+#define RECLAIM_BATCH 16
+
+/*用户池空闲页数的低水位和高水位。空闲页少于低水位时唤醒后台回收线程，
+它一直回收到空闲页不少于高水位为止*/
+static size_t low_water, high_water;
+
+/*唤醒后台回收线程*/
+static struct semaphore reclaim_wakeup;
+static bool reclaim_pending;    /*已经唤醒，还没有回收完*/
+
+/*回收的统计*/
+static long long direct_cnt;     /*缺页时自己换出的帧数*/
+static long long background_cnt; /*后台回收线程换出的帧数*/
+
+static struct frame *new_frame (void *kpage);
+static void *get_kpage (enum palloc_flags);
+static void attach_page (struct frame *, struct page *);
+static void detach_page (struct frame *, struct page *);
+static bool map_writable (struct frame *, struct page *);
+static bool needs_swap (struct frame *);
+static struct frame *pick_victim (void);
+static void write_back (struct frame *);
+static void *finish_eviction (struct frame *);
+static void *direct_reclaim (void);
+static void wake_reclaim (void);
+static thread_func reclaim_thread NO_RETURN;
+static struct frame *clock_next (void);
+static void unlink_frame (struct frame *);
+static void wait_io (struct page *);
+static hash_hash_func cache_hash;
+static hash_less_func cache_less;
+
+/* Initializes the frame table. */
+void
+frame_init (void)
+{
+  list_init (&frame_table);
+  if (!hash_init (&page_cache, cache_hash, cache_less, NULL))
+    PANIC ("frame: cannot allocate page cache");
+  lock_init (&frame_lock);
+  cond_init (&io_done);
+  clock_hand = NULL;
+  sema_init (&reclaim_wakeup, 0);
+}
+
+/* Starts the background reclaim thread.  The watermarks are
+   derived from the size of the user pool, so this must be
+   called before any user page is allocated. */
+void
+frame_reclaim_start (void)
+{
+  size_t pool_pages = palloc_free_count (PAL_USER);
+
+  low_water = pool_pages / 64 + 4;
+  high_water = 2 * low_water;
+  if (high_water > pool_pages / 2)
+    low_water = high_water = 0;
+  thread_create ("reclaimd", PRI_DEFAULT, reclaim_thread, NULL);
+}
+
+/* Prints frame reclaim statistics. */
+void
+frame_print_stats (void)
+{
+  printf ("Frames: %lld reclaimed directly, %lld in background\n",
+          direct_cnt, background_cnt);
+}
+
+/* Obtains a page from the user pool to hold PAGE, which must
+   not already have a frame, and returns its frame.  If the user
+   pool is exhausted, evicts another page to make room.  FLAGS
+   are interpreted as for palloc_get_page(); PAL_USER is
+   implied.  The frame is returned pinned, so that it is not
+   evicted while it is being filled; call frame_unpin() once it
+   is mapped.  Returns a null pointer if no frame is available. */
+struct frame *
+frame_alloc (struct page *page, enum palloc_flags flags)
+{
+  struct frame *f = NULL;
+  void *kpage;
+
+  ASSERT (page != NULL);
+  ASSERT (page->frame == NULL);
+
+  lock_acquire (&frame_lock);
+  kpage = get_kpage (flags);
+  if (kpage != NULL)
+    {
+      f = new_frame (kpage);
+      if (f != NULL)
+        attach_page (f, page);
+      else
+        palloc_free_page (kpage);
+    }
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Returns the page cache frame holding the BYTES bytes of INODE
+   at offset OFS, followed by zeros, and adds PAGE, which must
+   not already have a frame, to its mappings.  Reads the data
+   from INODE if it is not cached yet.  The frame is returned
+   pinned; call frame_unpin() once it is mapped.  Returns a null
+   pointer if no frame is available. */
+struct frame *
+frame_get_cached (struct page *page, struct inode *inode, off_t ofs,
+                  size_t bytes)
+{
+  struct frame key, *f;
+  struct hash_elem *e;
+  void *kpage = NULL;
+  off_t read;
+
+  ASSERT (page != NULL);
+  ASSERT (page->frame == NULL);
+  ASSERT (ofs % PGSIZE == 0);
+  ASSERT (bytes <= PGSIZE);
+
+  key.inode = inode;
+  key.ofs = ofs;
+  key.bytes = bytes;
+
+  lock_acquire (&frame_lock);
+  for (;;)
+    {
+      e = hash_find (&page_cache, &key.cache_elem);
+      if (e != NULL)
+        {
+          f = hash_entry (e, struct frame, cache_elem);
+          if (f->busy)
+            {
+              /*别的进程正在读入或者写回这一帧，等它完成后重新查找*/
+              cond_wait (&io_done, &frame_lock);
+              continue;
+            }
+          if (kpage != NULL)
+            palloc_free_page (kpage);
+          attach_page (f, page);
+          lock_release (&frame_lock);
+          return f;
+        }
+      if (kpage != NULL)
+        break;
+
+      /*换出其他帧时会暂时释放锁，别的进程可能在这期间读入了同一页，
+      所以拿到空闲页后要重新查找一次*/
+      kpage = get_kpage (0);
+      if (kpage == NULL)
+        {
+          lock_release (&frame_lock);
+          return NULL;
+        }
+    }
+
+  f = new_frame (kpage);
+  if (f == NULL)
+    {
+      palloc_free_page (kpage);
+      lock_release (&frame_lock);
+      return NULL;
+    }
+  f->inode = inode;
+  f->ofs = ofs;
+  f->bytes = bytes;
+  f->busy = true;
+  hash_insert (&page_cache, &f->cache_elem);
+  attach_page (f, page);
+  lock_release (&frame_lock);
+
+  /*读入文件内容时不持有锁，查找同一页的进程会等待busy被清除。
+  bytes是页缓存的键的一部分，读到的字节数少了也不能改它*/
+  read = inode_read_at (inode, kpage, bytes, ofs);
+  memset ((uint8_t *) kpage + read, 0, PGSIZE - read);
+
+  lock_acquire (&frame_lock);
+  f->busy = false;
+  cond_broadcast (&io_done, &frame_lock);
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Like frame_get_cached(), but only if the page cache already
+   holds the data and no I/O on it is in progress; otherwise
+   returns a null pointer without allocating or reading
+   anything. */
+struct frame *
+frame_find_cached (struct page *page, struct inode *inode, off_t ofs,
+                   size_t bytes)
+{
+  struct frame key, *f = NULL;
+  struct hash_elem *e;
+
+  ASSERT (page != NULL);
+  ASSERT (page->frame == NULL);
+
+  key.inode = inode;
+  key.ofs = ofs;
+  key.bytes = bytes;
+
+  lock_acquire (&frame_lock);
+  e = hash_find (&page_cache, &key.cache_elem);
+  if (e != NULL)
+    {
+      f = hash_entry (e, struct frame, cache_elem);
+      if (f->busy)
+        f = NULL;
+      else
+        attach_page (f, page);
+    }
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Returns true if CNT more pages can be brought in ahead of use
+   without pushing the user pool below the level that background
+   reclaim maintains. */
+bool
+frame_can_prefetch (size_t cnt)
+{
+  return palloc_free_count (PAL_USER) >= high_water + cnt;
+}
+
+/* Allows frame F to be evicted again, once every pin on it has
+   been released. */
+void
+frame_unpin (struct frame *f)
+{
+  lock_acquire (&frame_lock);
+  ASSERT (f->pin_cnt > 0);
+  f->pin_cnt--;
+  lock_release (&frame_lock);
+}
+
+/* Unmaps PAGE from its owner's page directory and detaches it
+   from its frame, if it has one.  The frame is freed when its
+   last page goes away; a page cache frame that was modified is
+   written back to its file first.  If PAGE is being evicted,
+   waits for the eviction to complete first. */
+void
+frame_release_page (struct page *page)
+{
+  struct frame *f;
+
+  lock_acquire (&frame_lock);
+  wait_io (page);
+  f = page->frame;
+  if (f == NULL || (detach_page (f, page), !list_empty (&f->pages)))
+    {
+      lock_release (&frame_lock);
+      return;
+    }
+
+  /*最后一个映射也撤销了。被写过的文件页要先写回文件，写回期间帧留在
+  页缓存中并标记为busy，这样别的进程不会从文件读到旧的内容*/
+  if (f->inode != NULL && f->dirty)
+    {
+      f->busy = true;
+      f->pin_cnt++;
+      lock_release (&frame_lock);
+      inode_write_at (f->inode, f->kpage, f->bytes, f->ofs);
+      lock_acquire (&frame_lock);
+      f->busy = false;
+      f->pin_cnt--;
+      cond_broadcast (&io_done, &frame_lock);
+    }
+  unlink_frame (f);
+  lock_release (&frame_lock);
+
+  palloc_free_page (f->kpage);
+  free (f);
+}
+
+/* Makes CHILD, a copy of PAGE in a process newly forked from
+   PAGE's owner, share PAGE's contents.  If PAGE is in a private
+   frame, both pages are mapped to it read-only, so that whichever
+   is written first gets its own copy in frame_copy_on_write();
+   page cache frames are simply shared.  If PAGE has been swapped
+   out, CHILD takes a reference to its swap slot.  CHILD's type is
+   set from PAGE's, since eviction may change it.  Returns true if
+   successful, false on memory allocation failure. */
+bool
+frame_share (struct page *page, struct page *child)
+{
+  struct frame *f;
+  bool success = true;
+
+  ASSERT (child->frame == NULL);
+
+  lock_acquire (&frame_lock);
+  wait_io (page);
+  f = page->frame;
+  child->type = page->type;
+  if (f == NULL)
+    {
+      if (page->swap_slot != SWAP_NONE)
+        child->swap_slot = swap_dup (page->swap_slot);
+    }
+  else
+    {
+      list_push_back (&f->pages, &child->frame_elem);
+      child->frame = f;
+      if (f->inode == NULL)
+        {
+          /*父进程原来的映射可能是可写的，改成只读。清除映射前把脏位记到帧上*/
+          uint32_t *pd = page->owner->pagedir;
+          if (pagedir_is_dirty (pd, page->upage))
+            f->dirty = true;
+          pagedir_clear_page (pd, page->upage);
+          pagedir_set_page (pd, page->upage, f->kpage, false);
+        }
+      if (!pagedir_set_page (child->owner->pagedir, child->upage, f->kpage,
+                             map_writable (f, child)))
+        {
+          list_remove (&child->frame_elem);
+          child->frame = NULL;
+          success = false;
+        }
+    }
+  lock_release (&frame_lock);
+  return success;
+}
+
+/* Handles a write to PAGE, which is writable but was mapped
+   read-only because its frame is shared with a forked process.
+   If other pages still map the frame, gives PAGE a private copy
+   of it; then maps PAGE writable.  Returns true if the write may
+   be retried, false if no frame is available for the copy. */
+bool
+frame_copy_on_write (struct page *page)
+{
+  uint32_t *pd = page->owner->pagedir;
+  struct frame *f;
+  bool success = true;
+
+  ASSERT (page->writable);
+
+  lock_acquire (&frame_lock);
+  wait_io (page);
+  f = page->frame;
+  if (f == NULL)
+    {
+      /*这期间被换出了，重新访问时会缺页，再把它调入*/
+      lock_release (&frame_lock);
+      return true;
+    }
+  ASSERT (f->inode == NULL);
+
+  if (list_size (&f->pages) > 1)
+    {
+      struct frame *copy = NULL;
+      void *kpage;
+
+      /*分配新帧时可能会暂时释放锁，pin住F以免它被换出*/
+      f->pin_cnt++;
+      kpage = get_kpage (0);
+      f->pin_cnt--;
+
+      /*释放锁期间其他共享这一帧的进程可能已经复制走或者退出了，
+      那样就不用再复制，直接改成可写*/
+      if (kpage != NULL && list_size (&f->pages) > 1)
+        {
+          copy = new_frame (kpage);
+          if (copy == NULL)
+            success = false;
+        }
+      else if (kpage == NULL)
+        success = false;
+      if (kpage != NULL && copy == NULL)
+        palloc_free_page (kpage);
+
+      if (copy != NULL)
+        {
+          memcpy (copy->kpage, f->kpage, PGSIZE);
+          copy->dirty = f->dirty;
+          detach_page (f, page);
+          list_push_back (&copy->pages, &page->frame_elem);
+          page->frame = copy;
+          f = copy;
+        }
+    }
+
+  if (success)
+    {
+      /*现在只有PAGE映射这一帧。原来的映射是只读的，不会有脏位*/
+      pagedir_clear_page (pd, page->upage);
+      pagedir_set_page (pd, page->upage, f->kpage, true);
+    }
+  lock_release (&frame_lock);
+  return success;
+}
+
+/* Returns true if PAGE is in a frame.  If PAGE's frame is
+   being evicted, waits until the eviction is complete. */
+bool
+frame_is_resident (struct page *page)
+{
+  bool resident;
+
+  lock_acquire (&frame_lock);
+  wait_io (page);
+  resident = page->frame != NULL;
+  lock_release (&frame_lock);
+  return resident;
+}
+
+/*为KPAGE新建一个帧并加入帧表，内存不足时返回NULL。必须持有frame_lock*/
+static struct frame *
+new_frame (void *kpage)
+{
+  struct frame *f = malloc (sizeof *f);
+  if (f == NULL)
+    return NULL;
+  f->kpage = kpage;
+  list_init (&f->pages);
+  f->dirty = false;
+  f->pin_cnt = 0;
+  f->busy = false;
+  f->swap_slot = SWAP_NONE;
+  f->inode = NULL;
+  f->ofs = 0;
+  f->bytes = 0;
+  list_push_back (&frame_table, &f->elem);
+  return f;
+}
+
+/*从用户池取一页，用户池用完时换出一个帧。FLAGS和palloc_get_page()的
+相同。必须持有frame_lock，换出时会暂时释放它*/
+static void *
+get_kpage (enum palloc_flags flags)
+{
+  void *kpage = palloc_get_page (PAL_USER | flags);
+  if (kpage == NULL)
+    {
+      kpage = direct_reclaim ();
+      if (kpage != NULL && (flags & PAL_ZERO))
+        memset (kpage, 0, PGSIZE);
+    }
+  if (palloc_free_count (PAL_USER) < low_water)
+    wake_reclaim ();
+  return kpage;
+}
+
+/*把页P加入帧F的映射中，并pin住F。必须持有frame_lock*/
+static void
+attach_page (struct frame *f, struct page *p)
+{
+  list_push_back (&f->pages, &p->frame_elem);
+  p->frame = f;
+  f->pin_cnt++;
+}
+
+/*撤销页P到帧F的映射，P写过的话记到F上。必须持有frame_lock*/
+static void
+detach_page (struct frame *f, struct page *p)
+{
+  uint32_t *pd = p->owner->pagedir;
+
+  pagedir_clear_page (pd, p->upage);
+  if (pagedir_is_dirty (pd, p->upage))
+    f->dirty = true;
+  list_remove (&p->frame_elem);
+  p->frame = NULL;
+}
+
+/*页P在帧F中时是否可以映射成可写的。被几个页共享的私有帧只能映射成
+只读的，写的时候再复制。必须持有frame_lock*/
+static bool
+map_writable (struct frame *f, struct page *p)
+{
+  return p->writable && (f->inode != NULL || list_size (&f->pages) == 1);
+}
+
+/*帧F被换出时是否要写到交换区。缓存文件的帧写回文件，不用交换区；
+其他的帧被写过或者内容只存在于内存中时要写到交换区。必须持有frame_lock*/
+static bool
+needs_swap (struct frame *f)
+{
+  struct list_elem *e;
+
+  if (f->inode != NULL)
+    return false;
+  if (f->dirty)
+    return true;
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    if (list_entry (e, struct page, frame_elem)->type == PAGE_ANON)
+      return true;
+  return false;
+}
+
+/*用时钟算法选出一个要换出的帧，撤销它的所有映射并把它标记为busy，
+所有的帧都不能换出时返回NULL。必须持有frame_lock。
+
+映射它的页中只要有一个最近被访问过，就清除它们的访问位，给它第二次机会。
+被写过的页和之前就只存在于内存或交换区中的页要写到交换区，被写过的文件
+缓存页要写回文件，其他的页直接丢弃，下次缺页时重新读入或清零*/
+static struct frame *
+pick_victim (void)
+{
+  size_t i, n = list_size (&frame_table);
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  /*两圈之内一定能找到访问位已经被清除的帧，除非所有的帧都被pin住了*/
+  for (i = 0; i < 2 * n; i++)
+    {
+      struct frame *f = clock_next ();
+      struct list_elem *e;
+      bool accessed = false;
+
+      if (f->pin_cnt > 0 || f->busy)
+        continue;
+      for (e = list_begin (&f->pages); e != list_end (&f->pages);
+           e = list_next (e))
+        {
+          struct page *p = list_entry (e, struct page, frame_elem);
+          uint32_t *pd = p->owner->pagedir;
+          if (pagedir_is_accessed (pd, p->upage))
+            {
+              pagedir_set_accessed (pd, p->upage, false);
+              accessed = true;
+            }
+        }
+      if (accessed)
+        continue;
+
+      /*先撤销所有的映射，之后进程再访问这一页会缺页，并等待换出完成。
+      脏位在撤销映射后仍然保留在页表项中*/
+      for (e = list_begin (&f->pages); e != list_end (&f->pages);
+           e = list_next (e))
+        {
+          struct page *p = list_entry (e, struct page, frame_elem);
+          uint32_t *pd = p->owner->pagedir;
+          pagedir_clear_page (pd, p->upage);
+          if (pagedir_is_dirty (pd, p->upage))
+            f->dirty = true;
+        }
+      f->busy = true;
+      return f;
+    }
+  return NULL;
+}
+
+/*把正在换出的帧F中需要保存的内容写到交换区或者文件。不需要持有
+frame_lock，F已经被标记为busy，不会被别人改动*/
+static void
+write_back (struct frame *f)
+{
+  ASSERT (f->busy);
+
+  if (f->inode != NULL)
+    {
+      if (f->dirty)
+        inode_write_at (f->inode, f->kpage, f->bytes, f->ofs);
+    }
+  else if (needs_swap (f))
+    f->swap_slot = swap_out (f->kpage);
+}
+
+/*完成帧F的换出，返回空出来的帧的内核虚拟地址。交换区满了没能写回时
+恢复F的映射并返回NULL。必须持有frame_lock*/
+static void *
+finish_eviction (struct frame *f)
+{
+  bool swap = needs_swap (f);
+  void *kpage = NULL;
+  struct list_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  f->busy = false;
+  if (swap && f->swap_slot == SWAP_NONE)
+    {
+      /*交换区满了，这一帧不能换出，恢复所有的映射*/
+      for (e = list_begin (&f->pages); e != list_end (&f->pages);
+           e = list_next (e))
+        {
+          struct page *p = list_entry (e, struct page, frame_elem);
+          uint32_t *pd = p->owner->pagedir;
+          pagedir_set_page (pd, p->upage, f->kpage, map_writable (f, p));
+          pagedir_set_dirty (pd, p->upage, true);
+        }
+    }
+  else
+    {
+      /*共享这一帧的每个页都引用同一个交换槽*/
+      bool first = true;
+      while (!list_empty (&f->pages))
+        {
+          struct page *p = list_entry (list_pop_front (&f->pages),
+                                       struct page, frame_elem);
+          p->frame = NULL;
+          if (swap)
+            {
+              p->type = PAGE_ANON;
+              p->swap_slot = first ? f->swap_slot : swap_dup (f->swap_slot);
+              first = false;
+            }
+        }
+      kpage = f->kpage;
+      unlink_frame (f);
+      free (f);
+    }
+  cond_broadcast (&io_done, &frame_lock);
+  return kpage;
+}
+
+/*缺页时用户池已经用完，自己换出一个帧，返回空出来的帧的内核虚拟地址，
+找不到可以换出的帧时返回NULL。必须持有frame_lock，写回时会暂时释放它*/
+static void *
+direct_reclaim (void)
+{
+  size_t tries = list_size (&frame_table);
+  void *kpage = NULL;
+
+  wake_reclaim ();
+  while (kpage == NULL && tries-- > 0)
+    {
+      struct frame *f = pick_victim ();
+      if (f == NULL)
+        break;
+      lock_release (&frame_lock);
+      write_back (f);
+      lock_acquire (&frame_lock);
+      kpage = finish_eviction (f);
+
+      /*写回期间后台回收线程可能已经释放了一些页*/
+      if (kpage == NULL)
+        kpage = palloc_get_page (PAL_USER);
+    }
+  if (kpage != NULL)
+    direct_cnt++;
+  return kpage;
+}
+
+/*唤醒后台回收线程，必须持有frame_lock*/
+static void
+wake_reclaim (void)
+{
+  if (!reclaim_pending && low_water > 0)
+    {
+      reclaim_pending = true;
+      sema_up (&reclaim_wakeup);
+    }
+}
+
+/*后台回收线程。被唤醒后一批一批地选出要换出的帧，释放锁之后一起写回，
+直到用户池的空闲页不少于高水位*/
+static void
+reclaim_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      sema_down (&reclaim_wakeup);
+
+      while (palloc_free_count (PAL_USER) < high_water)
+        {
+          struct frame *batch[RECLAIM_BATCH];
+          size_t want = high_water - palloc_free_count (PAL_USER);
+          size_t cnt = 0, freed = 0, i;
+
+          lock_acquire (&frame_lock);
+          while (cnt < RECLAIM_BATCH && cnt < want)
+            {
+              struct frame *f = pick_victim ();
+              if (f == NULL)
+                break;
+              batch[cnt++] = f;
+            }
+          lock_release (&frame_lock);
+          if (cnt == 0)
+            break;
+
+          for (i = 0; i < cnt; i++)
+            write_back (batch[i]);
+
+          lock_acquire (&frame_lock);
+          for (i = 0; i < cnt; i++)
+            {
+              void *kpage = finish_eviction (batch[i]);
+              if (kpage != NULL)
+                {
+                  palloc_free_page (kpage);
+                  freed++;
+                }
+            }
+          background_cnt += freed;
+          lock_release (&frame_lock);
+
+          /*交换区满了，一个也没能换出，等下次再唤醒*/
+          if (freed == 0)
+            break;
+        }
+
+      lock_acquire (&frame_lock);
+      reclaim_pending = false;
+      lock_release (&frame_lock);
+    }
+}
+
+/*把时钟指针向前移动一个帧，返回移动前指向的帧。必须持有frame_lock*/
+static struct frame *
+clock_next (void)
+{
+  struct frame *f;
+
+  ASSERT (!list_empty (&frame_table));
+
+  if (clock_hand == NULL || clock_hand == list_end (&frame_table))
+    clock_hand = list_begin (&frame_table);
+  f = list_entry (clock_hand, struct frame, elem);
+  clock_hand = list_next (clock_hand);
+  return f;
+}
+
+/*把已经没有映射的帧F从帧表和页缓存中取下。必须持有frame_lock*/
+static void
+unlink_frame (struct frame *f)
+{
+  ASSERT (list_empty (&f->pages));
+
+  if (clock_hand == &f->elem)
+    clock_hand = list_next (clock_hand);
+  list_remove (&f->elem);
+  if (f->inode != NULL)
+    hash_delete (&page_cache, &f->cache_elem);
+}
+
+/*页PAGE的帧正在进行I/O时等待I/O完成。必须持有frame_lock*/
+static void
+wait_io (struct page *page)
+{
+  while (page->frame != NULL && page->frame->busy)
+    cond_wait (&io_done, &frame_lock);
+}
+
+/*页缓存按照(inode, 偏移)散列。同一个位置可能被缓存两次：可执行文件的
+最后一页只读到段的末尾，其余清零，而映射文件时读到文件末尾，所以比较时
+还要比较字节数*/
+static unsigned
+cache_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct frame *f = hash_entry (e, struct frame, cache_elem);
+  return hash_bytes (&f->inode, sizeof f->inode) ^ hash_int (f->ofs);
+}
+
+static bool
+cache_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  const struct frame *fa = hash_entry (a, struct frame, cache_elem);
+  const struct frame *fb = hash_entry (b, struct frame, cache_elem);
+  if (fa->inode != fb->inode)
+    return fa->inode < fb->inode;
+  if (fa->ofs != fb->ofs)
+    return fa->ofs < fb->ofs;
+  return fa->bytes < fb->bytes;
+}
+/*Added by moon*/
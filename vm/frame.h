@@ -0,0 +1,69 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "threads/palloc.h"
+
+/*Added by moon*/
+/* Frame table.
+
+   Every page of the user pool that holds a user page has a
+   struct frame describing it.  All frames are kept on a single
+   global list, which the page replacement clock sweeps.
+
+   A frame may be mapped by more than one page.  Frames that
+   cache part of a file are also entered in a page cache keyed
+   by (inode, offset, length), so that every process mapping the
+   same part of the same file, or running the same executable,
+   shares one frame.  After fork(), a
+   private frame is shared by the parent's and the child's pages
+   and mapped read-only in both until one of them writes it
+   (copy-on-write).
+
+   A background reclaim thread keeps the number of free pages in
+   the user pool between a low and a high watermark, writing
+   back victims in batches, so that page faults rarely have to
+   evict a page themselves ("direct reclaim"). */
+
+struct page;
+struct inode;
+
+/* A physical frame holding a user page. */
+struct frame
+  {
+    void *kpage;                /* Kernel virtual address of frame. */
+    struct list pages;          /* Pages mapped to this frame. */
+    bool dirty;                 /* Written through an unmapped page? */
+    int pin_cnt;                /* Must not be evicted while nonzero. */
+    bool busy;                  /* I/O in progress? */
+    size_t swap_slot;           /* Swap slot written during eviction. */
+    struct list_elem elem;      /* Element in the frame table. */
+
+    /* Page cache frames only. */
+    struct inode *inode;        /* Cached file, or NULL. */
+    off_t ofs;                  /* Offset in INODE. */
+    size_t bytes;               /* Bytes of file data in frame. */
+    struct hash_elem cache_elem; /* Element in the page cache. */
+  };
+
+void frame_init (void);
+void frame_reclaim_start (void);
+void frame_print_stats (void);
+struct frame *frame_alloc (struct page *, enum palloc_flags);
+struct frame *frame_get_cached (struct page *, struct inode *, off_t ofs,
+                                size_t bytes);
+struct frame *frame_find_cached (struct page *, struct inode *, off_t ofs,
+                                 size_t bytes);
+bool frame_can_prefetch (size_t cnt);
+void frame_unpin (struct frame *);
+void frame_release_page (struct page *);
+bool frame_share (struct page *, struct page *child);
+bool frame_copy_on_write (struct page *);
+bool frame_is_resident (struct page *);
+/*Added by moon*/
+
+#endif /* vm/frame.h */
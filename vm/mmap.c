@@ -0,0 +1,184 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <round.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/page.h"
+
+/*Added by moon*/
+static void unmap (struct mapping *);
+
+/* Maps FILE into the current process's address space starting
+   at ADDR and returns the new mapping's identifier.  The mapping
+   uses its own reference to FILE, so the caller may close FILE
+   afterward.  Fails, returning MAP_FAILED, if FILE is empty, if
+   ADDR is null or not page-aligned, if any page of the range is
+   already in use, or if memory allocation fails. */
+mapid_t
+mmap_map (struct file *file, void *addr)
+{
+  struct thread *t = thread_current ();
+  struct mapping *m;
+  off_t length;
+  size_t i;
+
+  if (file == NULL || addr == NULL || pg_ofs (addr) != 0)
+    return MAP_FAILED;
+  length = file_length (file);
+  if (length == 0)
+    return MAP_FAILED;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return MAP_FAILED;
+  m->file = file_reopen (file);
+  if (m->file == NULL)
+    {
+      free (m);
+      return MAP_FAILED;
+    }
+  m->base = addr;
+  m->page_cnt = 0;
+  m->stream.next = NULL;
+  m->stream.window = 0;
+
+  /*逐页加入补充页表，页的内容在进程访问到时才通过页缓存读入*/
+  for (i = 0; i < DIV_ROUND_UP ((size_t) length, PGSIZE); i++)
+    {
+      uint8_t *upage = (uint8_t *) addr + i * PGSIZE;
+      off_t ofs = i * PGSIZE;
+      size_t read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+
+      if (!is_user_vaddr (upage) || upage < (uint8_t *) addr
+          || (uint8_t *) PHYS_BASE - upage <= STACK_MAX
+          || !page_add_mmap (upage, m->file, ofs, read_bytes))
+        {
+          unmap (m);
+          return MAP_FAILED;
+        }
+      m->page_cnt++;
+    }
+
+  m->id = t->next_mapid++;
+  list_push_back (&t->mappings, &m->elem);
+  return m->id;
+}
+
+/* Copies all of PARENT's mappings into the current process,
+   which must have none, keeping their identifiers.  Each copy
+   uses its own reference to the mapped file, and its pages
+   share PARENT's page cache frames.  PARENT must not run while
+   its mappings are copied.  Returns true if successful, false
+   on memory allocation failure. */
+bool
+mmap_copy (struct thread *parent)
+{
+  struct thread *t = thread_current ();
+  struct list_elem *e;
+
+  ASSERT (list_empty (&t->mappings));
+
+  for (e = list_begin (&parent->mappings); e != list_end (&parent->mappings);
+       e = list_next (e))
+    {
+      struct mapping *src = list_entry (e, struct mapping, elem);
+      struct mapping *m = malloc (sizeof *m);
+      size_t i;
+
+      if (m == NULL)
+        return false;
+      m->file = file_reopen (src->file);
+      if (m->file == NULL)
+        {
+          free (m);
+          return false;
+        }
+      m->id = src->id;
+      m->base = src->base;
+      m->page_cnt = 0;
+      m->stream.next = NULL;
+      m->stream.window = 0;
+      for (i = 0; i < src->page_cnt; i++)
+        {
+          if (!page_copy (parent, (uint8_t *) m->base + i * PGSIZE, m->file))
+            {
+              unmap (m);
+              return false;
+            }
+          m->page_cnt++;
+        }
+      list_push_back (&t->mappings, &m->elem);
+    }
+  t->next_mapid = parent->next_mapid;
+  return true;
+}
+
+/* Returns the current process's mapping that contains user
+   virtual address UPAGE, or a null pointer if there is none. */
+struct mapping *
+mmap_find (const void *upage)
+{
+  struct thread *t = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&t->mappings); e != list_end (&t->mappings);
+       e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if ((const uint8_t *) upage >= (const uint8_t *) m->base
+          && (const uint8_t *) upage
+             < (const uint8_t *) m->base + m->page_cnt * PGSIZE)
+        return m;
+    }
+  return NULL;
+}
+
+/* Unmaps the current process's mapping MAPPING, writing back
+   any modified pages that no other process still maps.  Returns
+   false if there is no such mapping. */
+bool
+mmap_unmap (mapid_t mapping)
+{
+  struct thread *t = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&t->mappings); e != list_end (&t->mappings);
+       e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->id == mapping)
+        {
+          list_remove (&m->elem);
+          unmap (m);
+          return true;
+        }
+    }
+  return false;
+}
+
+/* Unmaps all of the current process's mappings.  Called when
+   the process exits. */
+void
+mmap_unmap_all (void)
+{
+  struct thread *t = thread_current ();
+
+  while (!list_empty (&t->mappings))
+    unmap (list_entry (list_pop_front (&t->mappings),
+                       struct mapping, elem));
+}
+
+/*撤销映射M中已经建立的页，关闭文件并释放M*/
+static void
+unmap (struct mapping *m)
+{
+  size_t i;
+
+  for (i = 0; i < m->page_cnt; i++)
+    page_remove ((uint8_t *) m->base + i * PGSIZE);
+  file_close (m->file);
+  free (m);
+}
+/*Added by moon*/
@@ -0,0 +1,43 @@
+#ifndef VM_MMAP_H
+#define VM_MMAP_H
+
+#include <list.h>
+#include <stddef.h>
+#include "vm/page.h"
+
+/*Added by moon*/
+/* Memory-mapped files.
+
+   A mapping makes consecutive pages of a process's address
+   space refer to consecutive pages of a file.  The pages are
+   brought in on demand through the page cache, so processes
+   that map the same file share frames, and modified pages are
+   written back lazily: when the last process unmaps them, when
+   they are evicted, or when the mapping processes exit. */
+
+/* Map region identifier. */
+typedef int mapid_t;
+#define MAP_FAILED ((mapid_t) -1)
+
+struct file;
+struct thread;
+
+/* A memory-mapped file in a process. */
+struct mapping
+  {
+    mapid_t id;                 /* Mapping identifier. */
+    struct file *file;          /* File mapped. */
+    void *base;                 /* First page of the mapping. */
+    size_t page_cnt;            /* Number of pages mapped. */
+    struct fault_stream stream; /* Sequential fault detection. */
+    struct list_elem elem;      /* Element in thread's mapping list. */
+  };
+
+mapid_t mmap_map (struct file *, void *addr);
+bool mmap_copy (struct thread *parent);
+struct mapping *mmap_find (const void *upage);
+bool mmap_unmap (mapid_t);
+void mmap_unmap_all (void);
+/*Added by moon*/
+
+#endif /* vm/mmap.h */
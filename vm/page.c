@@ -0,0 +1,434 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/mmap.h"
+#include "vm/swap.h"
+
+/*Added by moon*/
+/*缺页时顺便映射同一个对齐窗口内已经在页缓存中的页，窗口的页数*/
+#define FAULT_AROUND_PAGES 16
+
+/*顺序缺页时预先调入的页数的初值和上限*/
+#define READ_AHEAD_MIN 2
+#define READ_AHEAD_MAX 32
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static hash_action_func page_destroy;
+static struct page *page_create (void *upage, bool writable);
+static bool copy_page (struct page *src, struct file *file);
+static bool is_cached (const struct page *);
+static bool map_frame (struct page *, struct frame *);
+static void fault_around (struct page *);
+static void read_ahead (struct page *);
+static struct fault_stream *stream_of (struct page *);
+
+/* Initializes the current process's supplemental page table.
+   Returns true if successful, false on memory allocation
+   failure. */
+bool
+page_table_init (void)
+{
+  return hash_init (&thread_current ()->pages, page_hash, page_less, NULL);
+}
+
+/* Destroys the current process's supplemental page table,
+   unmapping every page and freeing its frame.  Must be called
+   before the process's page directory is destroyed. */
+void
+page_table_destroy (void)
+{
+  hash_destroy (&thread_current ()->pages, page_destroy);
+}
+
+/* Returns the current process's page containing user virtual
+   address VADDR, or a null pointer if there is no such page. */
+struct page *
+page_lookup (const void *vaddr)
+{
+  struct page p;
+  struct hash_elem *e;
+
+  p.upage = pg_round_down (vaddr);
+  e = hash_find (&thread_current ()->pages, &p.elem);
+  return e != NULL ? hash_entry (e, struct page, elem) : NULL;
+}
+
+/* Adds a page at UPAGE to the current process's address space
+   that reads as all zeros when first touched.  Returns true if
+   successful, false if UPAGE is already in use or memory
+   allocation fails. */
+bool
+page_add_zero (void *upage, bool writable)
+{
+  struct page *p = page_create (upage, writable);
+  if (p == NULL)
+    return false;
+  p->type = PAGE_ZERO;
+  return true;
+}
+
+/* Adds a page at UPAGE to the current process's address space
+   whose first READ_BYTES bytes are read from FILE at offset OFS
+   when first touched, and whose remaining bytes are zeroed.
+   FILE must stay open as long as the page exists.  Returns true
+   if successful, false if UPAGE is already in use or memory
+   allocation fails. */
+bool
+page_add_file (void *upage, struct file *file, off_t ofs,
+               size_t read_bytes, bool writable)
+{
+  struct page *p;
+
+  ASSERT (read_bytes <= PGSIZE);
+
+  p = page_create (upage, writable);
+  if (p == NULL)
+    return false;
+  p->type = PAGE_FILE;
+  p->file = file;
+  p->ofs = ofs;
+  p->read_bytes = read_bytes;
+  return true;
+}
+
+/* Copies every page of PARENT's supplemental page table, other
+   than memory-mapped pages, into the current process's, sharing
+   their contents copy-on-write.  Pages read from PARENT's
+   executable read from the current process's exec_file instead,
+   which must already be open.  PARENT must not run while its
+   table is copied.  Returns true if successful, false on memory
+   allocation failure, in which case some pages may have been
+   copied. */
+bool
+page_table_copy (struct thread *parent)
+{
+  struct hash_iterator i;
+
+  hash_first (&i, &parent->pages);
+  while (hash_next (&i))
+    {
+      struct page *src = hash_entry (hash_cur (&i), struct page, elem);
+      if (src->type != PAGE_MMAP
+          && !copy_page (src, thread_current ()->exec_file))
+        return false;
+    }
+  return true;
+}
+
+/* Copies PARENT's page at UPAGE, which must exist, into the
+   current process's address space, sharing its contents
+   copy-on-write.  The copy reads from FILE instead of the
+   original page's file.  Returns true if successful, false on
+   memory allocation failure. */
+bool
+page_copy (struct thread *parent, void *upage, struct file *file)
+{
+  struct page p;
+  struct hash_elem *e;
+
+  p.upage = upage;
+  e = hash_find (&parent->pages, &p.elem);
+  ASSERT (e != NULL);
+  return copy_page (hash_entry (e, struct page, elem), file);
+}
+
+/* Handles a fault on user virtual address VADDR in the current
+   process.  If VADDR belongs to a page that is not yet in
+   memory, brings it in, together with nearby pages that are
+   already cached and, if the process has been faulting
+   sequentially, a window of the pages that follow; if WRITE is
+   true and the page is
+   writable but mapped read-only because it is shared with a
+   forked process, copies it.  If VADDR is just below ESP, the
+   user stack pointer at the time of the fault, the stack is
+   grown to cover it; ESP may be null if it is not known.
+   Returns true if the faulting access may be retried, false if
+   it was invalid. */
+bool
+page_fault_in (const void *vaddr, bool write, const void *esp)
+{
+  struct page *p;
+
+  if (!is_user_vaddr (vaddr))
+    return false;
+
+  p = page_lookup (vaddr);
+  if (p == NULL)
+    {
+      /*PUSHA指令会在压栈前访问esp下方32字节处，再往下的访问都不是合法的栈访问*/
+      if (esp == NULL
+          || (uint8_t *) vaddr < (uint8_t *) esp - 32
+          || (uint8_t *) vaddr < (uint8_t *) PHYS_BASE - STACK_MAX)
+        return false;
+      if (!page_add_zero (pg_round_down (vaddr), true))
+        return false;
+      p = page_lookup (vaddr);
+    }
+  else if (frame_is_resident (p))
+    {
+      /*页已经在内存中，出错是因为写了只读映射的页。可写的页只读映射时
+      是和fork出来的进程共享的，复制一份后重新执行*/
+      if (!write || !p->writable)
+        return false;
+      return frame_copy_on_write (p);
+    }
+
+  if (!page_in (p))
+    return false;
+  fault_around (p);
+  read_ahead (p);
+  return true;
+}
+
+/* Brings page P, which must not already be in memory, into a
+   frame and maps it into its owner's page directory.  Returns
+   true if successful, false on failure. */
+bool
+page_in (struct page *p)
+{
+  struct frame *f;
+
+  ASSERT (p->frame == NULL);
+
+  /*映射文件的页和可执行文件的只读段放在页缓存中，映射同一个文件的进程、
+  运行同一个程序的进程共享同一帧*/
+  if (is_cached (p))
+    f = frame_get_cached (p, file_get_inode (p->file), p->ofs, p->read_bytes);
+  else
+    f = frame_alloc (p, p->type == PAGE_ZERO ? PAL_ZERO : 0);
+  if (f == NULL)
+    return false;
+
+  if (p->type == PAGE_ANON)
+    {
+      /*换出过的页从交换区读回，交换槽随即释放，之后这一页只存在于内存中，
+      再次换出时总要重新写到交换区*/
+      ASSERT (p->swap_slot != SWAP_NONE);
+      swap_in (p->swap_slot, f->kpage);
+      p->swap_slot = SWAP_NONE;
+    }
+  else if (p->type == PAGE_FILE && f->inode == NULL)
+    {
+      if (file_read_at (p->file, f->kpage, p->read_bytes, p->ofs)
+          != (off_t) p->read_bytes)
+        goto fail;
+      memset ((uint8_t *) f->kpage + p->read_bytes, 0,
+              PGSIZE - p->read_bytes);
+    }
+
+  return map_frame (p, f);
+
+ fail:
+  frame_unpin (f);
+  frame_release_page (p);
+  return false;
+}
+
+/* Adds a page at UPAGE to the current process's address space
+   that maps the READ_BYTES bytes of FILE at offset OFS, followed
+   by zeros.  The page is shared through the page cache with
+   every other process that maps the same part of the same file,
+   and modifications are written back to FILE.  Returns true if
+   successful, false if UPAGE is already in use or memory
+   allocation fails. */
+bool
+page_add_mmap (void *upage, struct file *file, off_t ofs, size_t read_bytes)
+{
+  if (!page_add_file (upage, file, ofs, read_bytes, true))
+    return false;
+  page_lookup (upage)->type = PAGE_MMAP;
+  return true;
+}
+
+/* Removes the current process's page at UPAGE, which must exist,
+   from its address space.  A modified memory-mapped page is
+   written back to its file once no process maps it anymore. */
+void
+page_remove (void *upage)
+{
+  struct page *p = page_lookup (upage);
+
+  ASSERT (p != NULL);
+  hash_delete (&thread_current ()->pages, &p->elem);
+  page_destroy (&p->elem, NULL);
+}
+
+/*新建一个在UPAGE处的页并加入当前进程的补充页表，UPAGE已经被占用或者
+内存不足时返回NULL。页的内容来源由调用者填写*/
+static struct page *
+page_create (void *upage, bool writable)
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+
+  p = calloc (1, sizeof *p);
+  if (p == NULL)
+    return NULL;
+  p->upage = upage;
+  p->owner = t;
+  p->writable = writable;
+  p->swap_slot = SWAP_NONE;
+  if (hash_insert (&t->pages, &p->elem) != NULL)
+    {
+      free (p);
+      return NULL;
+    }
+  return p;
+}
+
+/*把别的进程的页SRC复制到当前进程，内容通过frame_share()写时复制共享。
+复制出来的页从FILE读入*/
+static bool
+copy_page (struct page *src, struct file *file)
+{
+  struct page *p = page_create (src->upage, src->writable);
+  if (p == NULL)
+    return false;
+  p->file = file;
+  p->ofs = src->ofs;
+  p->read_bytes = src->read_bytes;
+  if (!frame_share (src, p))
+    {
+      page_remove (p->upage);
+      return false;
+    }
+  return true;
+}
+
+/*页P的内容是否通过页缓存共享*/
+static bool
+is_cached (const struct page *p)
+{
+  return p->type == PAGE_MMAP || (p->type == PAGE_FILE && !p->writable);
+}
+
+/*把页P映射到已经pin住并填好内容的帧F，然后解除pin。失败时撤销P到F的
+对应关系*/
+static bool
+map_frame (struct page *p, struct frame *f)
+{
+  bool success = pagedir_set_page (p->owner->pagedir, p->upage, f->kpage,
+                                   p->writable);
+  frame_unpin (f);
+  if (!success)
+    frame_release_page (p);
+  return success;
+}
+
+/*页P刚刚调入，把P所在的对齐窗口中其他已经在页缓存里的页也映射上，
+省去以后访问它们时的缺页。不做任何I/O*/
+static void
+fault_around (struct page *p)
+{
+  uint8_t *base;
+  size_t i;
+
+  if (!is_cached (p))
+    return;
+
+  base = (uint8_t *) ((uintptr_t) p->upage
+                      & ~((uintptr_t) FAULT_AROUND_PAGES * PGSIZE - 1));
+  for (i = 0; i < FAULT_AROUND_PAGES; i++)
+    {
+      struct page *q = page_lookup (base + i * PGSIZE);
+      struct frame *f;
+
+      if (q == NULL || q == p || q->frame != NULL || !is_cached (q))
+        continue;
+      f = frame_find_cached (q, file_get_inode (q->file), q->ofs,
+                             q->read_bytes);
+      if (f != NULL)
+        map_frame (q, f);
+    }
+}
+
+/*页P刚刚调入。如果这次缺页正好落在同一个顺序流上一次预先调入的页之后，
+就把预读窗口加倍，预先调入P后面窗口内的页；否则重新开始检测*/
+static void
+read_ahead (struct page *p)
+{
+  struct fault_stream *s = stream_of (p);
+  uint8_t *upage = p->upage;
+  size_t i;
+
+  if (upage != s->next)
+    {
+      s->window = 0;
+      s->next = upage + PGSIZE;
+      return;
+    }
+
+  s->window = s->window == 0 ? READ_AHEAD_MIN : s->window * 2;
+  if (s->window > READ_AHEAD_MAX)
+    s->window = READ_AHEAD_MAX;
+
+  /*空闲页不多时不预读，免得把马上要用的页挤出去*/
+  if (!frame_can_prefetch (s->window))
+    {
+      s->next = upage + PGSIZE;
+      return;
+    }
+
+  for (i = 1; i <= s->window; i++)
+    {
+      struct page *q = page_lookup (upage + i * PGSIZE);
+      if (q == NULL || stream_of (q) != s)
+        break;
+      if (q->frame == NULL && !page_in (q))
+        break;
+    }
+  s->next = upage + i * PGSIZE;
+}
+
+/*页P所属的顺序流：映射文件的页属于它所在的映射，其他的页属于进程*/
+static struct fault_stream *
+stream_of (struct page *p)
+{
+  if (p->type == PAGE_MMAP)
+    {
+      struct mapping *m = mmap_find (p->upage);
+      if (m != NULL)
+        return &m->stream;
+    }
+  return &p->owner->stream;
+}
+
+/*页按照用户虚拟地址散列*/
+static unsigned
+page_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (e, struct page, elem);
+  return hash_bytes (&p->upage, sizeof p->upage);
+}
+
+static bool
+page_less (const struct hash_elem *a, const struct hash_elem *b,
+           void *aux UNUSED)
+{
+  const struct page *pa = hash_entry (a, struct page, elem);
+  const struct page *pb = hash_entry (b, struct page, elem);
+  return pa->upage < pb->upage;
+}
+
+/*撤销一个页的映射，释放它占用的帧、交换槽和它本身*/
+static void
+page_destroy (struct hash_elem *e, void *aux UNUSED)
+{
+  struct page *p = hash_entry (e, struct page, elem);
+
+  frame_release_page (p);
+  if (p->swap_slot != SWAP_NONE)
+    swap_free (p->swap_slot);
+  free (p);
+}
+/*Added by moon*/
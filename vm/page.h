@@ -0,0 +1,84 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+
+/*Added by moon*/
+/* Supplemental page table.
+
+   Each process has a hash table, keyed by user virtual address,
+   that records for every page of its address space where the
+   page's contents come from.  A page is brought into a frame
+   only when the process first touches it: page_fault() in
+   userprog/exception.c calls page_fault_in(), which allocates a
+   frame, fills it and maps it into the page directory.
+
+   fork() copies a process's table without copying any memory:
+   the child's pages share the parent's frames and swap slots,
+   and a private frame is copied only when one of the processes
+   first writes it. */
+
+/* Where a page's contents come from when it is faulted in. */
+enum page_type
+  {
+    PAGE_ZERO,                  /* All zeros. */
+    PAGE_FILE,                  /* Read from a file, rest zeros. */
+    PAGE_ANON,                  /* Only in memory or in swap. */
+    PAGE_MMAP                   /* Shared mapping of a file. */
+  };
+
+/* A page of a process's virtual address space. */
+struct page
+  {
+    void *upage;                /* User virtual address. */
+    struct thread *owner;       /* Process the page belongs to. */
+    bool writable;              /* May the process write it? */
+    enum page_type type;        /* Where the contents come from. */
+    struct frame *frame;        /* Frame holding it, or NULL. */
+    struct list_elem frame_elem; /* Element in frame's page list. */
+
+    /* PAGE_FILE and PAGE_MMAP only. */
+    struct file *file;          /* File to read. */
+    off_t ofs;                  /* Offset in FILE. */
+    size_t read_bytes;          /* Bytes to read; the rest are zeroed. */
+
+    /* PAGE_ANON only. */
+    size_t swap_slot;           /* Swap slot holding it, or SWAP_NONE. */
+
+    struct hash_elem elem;      /* Element in the supplemental page table. */
+  };
+
+/* Sequential fault detection.  A process keeps one stream for
+   each memory-mapped file and one for the rest of its address
+   space.  When a fault hits the page just past the ones brought
+   in for the previous fault of the same stream, a window of the
+   following pages is faulted in along with it, and the window
+   doubles on each further sequential fault. */
+struct fault_stream
+  {
+    void *next;                 /* Page a sequential fault would hit. */
+    size_t window;              /* Pages brought in ahead last time. */
+  };
+
+/* Maximum size of a process's stack, in bytes. */
+#define STACK_MAX (8 * 1024 * 1024)
+
+bool page_table_init (void);
+void page_table_destroy (void);
+struct page *page_lookup (const void *vaddr);
+bool page_add_zero (void *upage, bool writable);
+bool page_add_file (void *upage, struct file *, off_t ofs,
+                    size_t read_bytes, bool writable);
+bool page_add_mmap (void *upage, struct file *, off_t ofs,
+                    size_t read_bytes);
+void page_remove (void *upage);
+bool page_table_copy (struct thread *parent);
+bool page_copy (struct thread *parent, void *upage, struct file *);
+bool page_fault_in (const void *vaddr, bool write, const void *esp);
+bool page_in (struct page *);
+/*Added by moon*/
+
+#endif /* vm/page.h */
@@ -0,0 +1,118 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/*Added by moon*/
+/*每个交换槽占用的扇区数*/
+#define SECTORS_PER_SLOT (PGSIZE / BLOCK_SECTOR_SIZE)
+
+static struct block *swap_device;
+
+/*每个交换槽是否被占用，没有交换设备时为NULL*/
+static struct bitmap *used_slots;
+
+/*每个交换槽被多少个页引用。fork出来的进程和父进程共享换出的页，
+引用数减到0时才释放交换槽*/
+static uint16_t *slot_refs;
+
+/*保护used_slots和slot_refs*/
+static struct lock swap_lock;
+
+/* Sets up swap space on the BLOCK_SWAP device, if there is
+   one.  Without a swap device, swap_out() always fails. */
+void
+swap_init (void)
+{
+  lock_init (&swap_lock);
+  swap_device = block_get_role (BLOCK_SWAP);
+  if (swap_device == NULL)
+    {
+      printf ("swap: no swap device, dirty pages cannot be evicted\n");
+      return;
+    }
+  used_slots = bitmap_create (block_size (swap_device) / SECTORS_PER_SLOT);
+  if (used_slots == NULL)
+    PANIC ("swap: cannot allocate slot bitmap");
+  slot_refs = calloc (bitmap_size (used_slots), sizeof *slot_refs);
+  if (slot_refs == NULL)
+    PANIC ("swap: cannot allocate slot reference counts");
+}
+
+/* Writes the page at KPAGE to a free swap slot and returns the
+   slot number, or SWAP_NONE if swap space is full or there is
+   no swap device. */
+size_t
+swap_out (const void *kpage)
+{
+  size_t slot;
+  int i;
+
+  if (used_slots == NULL)
+    return SWAP_NONE;
+
+  lock_acquire (&swap_lock);
+  slot = bitmap_scan_and_flip (used_slots, 0, 1, false);
+  if (slot != BITMAP_ERROR)
+    slot_refs[slot] = 1;
+  lock_release (&swap_lock);
+  if (slot == BITMAP_ERROR)
+    return SWAP_NONE;
+
+  for (i = 0; i < SECTORS_PER_SLOT; i++)
+    block_write (swap_device, slot * SECTORS_PER_SLOT + i,
+                 (const uint8_t *) kpage + i * BLOCK_SECTOR_SIZE);
+  return slot;
+}
+
+/* Reads swap slot SLOT into the page at KPAGE and drops one
+   reference to the slot. */
+void
+swap_in (size_t slot, void *kpage)
+{
+  int i;
+
+  ASSERT (used_slots != NULL);
+  ASSERT (bitmap_test (used_slots, slot));
+
+  for (i = 0; i < SECTORS_PER_SLOT; i++)
+    block_read (swap_device, slot * SECTORS_PER_SLOT + i,
+                (uint8_t *) kpage + i * BLOCK_SECTOR_SIZE);
+  swap_free (slot);
+}
+
+/* Adds a reference to swap slot SLOT, which must be in use, so
+   that one more page may read it back, and returns SLOT. */
+size_t
+swap_dup (size_t slot)
+{
+  ASSERT (used_slots != NULL);
+
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (used_slots, slot));
+  ASSERT (slot_refs[slot] < UINT16_MAX);
+  slot_refs[slot]++;
+  lock_release (&swap_lock);
+  return slot;
+}
+
+/* Drops one reference to swap slot SLOT without reading it.
+   The slot is freed when its last reference is dropped. */
+void
+swap_free (size_t slot)
+{
+  ASSERT (used_slots != NULL);
+
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (used_slots, slot));
+  ASSERT (slot_refs[slot] > 0);
+  if (--slot_refs[slot] == 0)
+    bitmap_reset (used_slots, slot);
+  lock_release (&swap_lock);
+}
+/*Added by moon*/
@@ -0,0 +1,25 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*Added by moon*/
+/* Swap space.
+
+   The block device in the BLOCK_SWAP role is divided into
+   page-size slots.  A bitmap records which slots are in use.
+   A slot may be shared by several pages after fork(), so each
+   slot also has a reference count. */
+
+/* Slot number that refers to no slot. */
+#define SWAP_NONE ((size_t) -1)
+
+void swap_init (void);
+size_t swap_out (const void *kpage);
+void swap_in (size_t slot, void *kpage);
+size_t swap_dup (size_t slot);
+void swap_free (size_t slot);
+/*Added by moon*/
+
+#endif /* vm/swap.h */